@@ -0,0 +1,241 @@
+#include "AllocationTracker.hpp"
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+#if defined(__cpp_aligned_new) && defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace {
+	struct PhaseCounts {
+		//updated by operator new (from any thread):
+		std::atomic< uint64_t > frame_allocations{0};
+		std::atomic< uint64_t > frame_bytes{0};
+		std::atomic< uint64_t > total_allocations{0};
+		std::atomic< uint64_t > total_bytes{0};
+		//only touched by the main loop, in allocation_end_frame:
+		uint32_t budget = -1U;
+		uint64_t worst_frame = 0; //most allocations in one frame
+		uint64_t frames_over = 0; //frames over budget
+	};
+
+	//(plain static storage, so it is usable by allocations made before main() or during static init)
+	std::array< PhaseCounts, AllocationPhaseCount > counts;
+
+	thread_local AllocationPhase current_phase = AllocationOther;
+
+	void count_allocation(size_t size) {
+		PhaseCounts &phase = counts[current_phase];
+		phase.frame_allocations.fetch_add(1, std::memory_order_relaxed);
+		phase.frame_bytes.fetch_add(size, std::memory_order_relaxed);
+		phase.total_allocations.fetch_add(1, std::memory_order_relaxed);
+		phase.total_bytes.fetch_add(size, std::memory_order_relaxed);
+	}
+
+	void *counted_malloc(size_t size) {
+		count_allocation(size);
+		return std::malloc(size ? size : 1);
+	}
+
+#ifdef __cpp_aligned_new
+	//for over-aligned types (alignas(32) and up); these need their own free, so they pair with aligned_free:
+	void *counted_aligned_malloc(size_t size, std::align_val_t align) {
+		count_allocation(size);
+		size_t alignment = size_t(align);
+		if (alignment < sizeof(void *)) alignment = sizeof(void *); //posix_memalign's minimum
+		if (size == 0) size = 1;
+	#ifdef _WIN32
+		return _aligned_malloc(size, alignment);
+	#else
+		void *ret = nullptr;
+		if (posix_memalign(&ret, alignment, size) != 0) return nullptr;
+		return ret;
+	#endif
+	}
+
+	void aligned_free(void *ptr) {
+	#ifdef _WIN32
+		_aligned_free(ptr);
+	#else
+		std::free(ptr);
+	#endif
+	}
+#endif
+}
+
+//---------------------------------------------
+//global allocation functions:
+
+void *operator new(size_t size) {
+	void *ret = counted_malloc(size);
+	if (!ret) throw std::bad_alloc();
+	return ret;
+}
+
+void *operator new[](size_t size) {
+	void *ret = counted_malloc(size);
+	if (!ret) throw std::bad_alloc();
+	return ret;
+}
+
+void *operator new(size_t size, std::nothrow_t const &) noexcept {
+	return counted_malloc(size);
+}
+
+void *operator new[](size_t size, std::nothrow_t const &) noexcept {
+	return counted_malloc(size);
+}
+
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, std::nothrow_t const &) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::nothrow_t const &) noexcept {
+	std::free(ptr);
+}
+
+#ifdef __cpp_aligned_new
+void *operator new(size_t size, std::align_val_t align) {
+	void *ret = counted_aligned_malloc(size, align);
+	if (!ret) throw std::bad_alloc();
+	return ret;
+}
+
+void *operator new[](size_t size, std::align_val_t align) {
+	void *ret = counted_aligned_malloc(size, align);
+	if (!ret) throw std::bad_alloc();
+	return ret;
+}
+
+void *operator new(size_t size, std::align_val_t align, std::nothrow_t const &) noexcept {
+	return counted_aligned_malloc(size, align);
+}
+
+void *operator new[](size_t size, std::align_val_t align, std::nothrow_t const &) noexcept {
+	return counted_aligned_malloc(size, align);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+	aligned_free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+	aligned_free(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept {
+	aligned_free(ptr);
+}
+
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept {
+	aligned_free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t, std::nothrow_t const &) noexcept {
+	aligned_free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t, std::nothrow_t const &) noexcept {
+	aligned_free(ptr);
+}
+#endif
+
+//---------------------------------------------
+
+char const *allocation_phase_name(AllocationPhase phase) {
+	switch (phase) {
+		case AllocationOther: return "other";
+		case AllocationEvents: return "events";
+		case AllocationUpdate: return "update";
+		case AllocationDraw: return "draw";
+		default: return "?";
+	}
+}
+
+AllocationScope::AllocationScope(AllocationPhase phase) : previous(current_phase) {
+	assert(phase < AllocationPhaseCount);
+	current_phase = phase;
+}
+
+AllocationScope::~AllocationScope() {
+	current_phase = previous;
+}
+
+AllocationCounts allocation_frame_counts(AllocationPhase phase) {
+	AllocationCounts ret;
+	ret.allocations = counts[phase].frame_allocations.load(std::memory_order_relaxed);
+	ret.bytes = counts[phase].frame_bytes.load(std::memory_order_relaxed);
+	return ret;
+}
+
+AllocationCounts allocation_total_counts(AllocationPhase phase) {
+	AllocationCounts ret;
+	ret.allocations = counts[phase].total_allocations.load(std::memory_order_relaxed);
+	ret.bytes = counts[phase].total_bytes.load(std::memory_order_relaxed);
+	return ret;
+}
+
+void set_allocation_budget(AllocationPhase phase, uint32_t allocations) {
+	counts[phase].budget = allocations;
+}
+
+bool allocation_end_frame(bool check_budgets) {
+	bool ok = true;
+	for (uint32_t p = 0; p < AllocationPhaseCount; ++p) {
+		PhaseCounts &phase = counts[p];
+		uint64_t allocations = phase.frame_allocations.exchange(0, std::memory_order_relaxed);
+		uint64_t bytes = phase.frame_bytes.exchange(0, std::memory_order_relaxed);
+		if (!check_budgets) continue;
+		if (allocations > phase.worst_frame) phase.worst_frame = allocations;
+		if (phase.budget != -1U && allocations > phase.budget) {
+			phase.frames_over += 1;
+			std::cerr << "Allocation budget exceeded in " << allocation_phase_name(AllocationPhase(p)) << ": "
+				<< allocations << " allocations (" << bytes << " bytes) this frame; budget is " << phase.budget << "." << std::endl;
+			ok = false;
+		}
+	}
+	assert(ok && "allocation budget exceeded (see message above)");
+	return ok;
+}
+
+void allocation_report(std::ostream &out) {
+	std::ios_base::fmtflags flags = out.flags();
+	out << "heap allocations:\n";
+	out << "  " << std::left << std::setw(8) << "phase" << std::right
+		<< std::setw(14) << "allocations" << std::setw(14) << "bytes" << std::setw(14) << "worst frame"
+		<< std::setw(10) << "budget" << std::setw(14) << "frames over" << "\n";
+	for (uint32_t p = 0; p < AllocationPhaseCount; ++p) {
+		PhaseCounts const &phase = counts[p];
+		out << "  " << std::left << std::setw(8) << allocation_phase_name(AllocationPhase(p)) << std::right
+			<< std::setw(14) << phase.total_allocations.load(std::memory_order_relaxed)
+			<< std::setw(14) << phase.total_bytes.load(std::memory_order_relaxed)
+			<< std::setw(14) << phase.worst_frame;
+		if (phase.budget == -1U) out << std::setw(10) << "-";
+		else out << std::setw(10) << phase.budget;
+		out << std::setw(14) << phase.frames_over << "\n";
+	}
+	out.flush();
+	out.flags(flags);
+}
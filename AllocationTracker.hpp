@@ -0,0 +1,59 @@
+#pragma once
+
+/*
+ * AllocationTracker -- counts heap allocations per main-loop phase, and checks them against per-frame budgets.
+ *
+ * Linking AllocationTracker.cpp replaces the global operator new/delete with versions that count
+ *  every allocation (and its size) against the phase the allocating thread is in.
+ * (The over-aligned forms are replaced too, when the compiler has them -- i.e., __cpp_aligned_new.)
+ * So it is opt-in: the game only links it when built with 'jam -sTRACK_ALLOCATIONS=1' (see Jamfile),
+ *  which also defines TRACK_ALLOCATIONS so main.cpp marks its phases and checks budgets each frame.
+ *
+ * When a phase goes over budget, allocation_end_frame() prints the counts and asserts (in builds without NDEBUG),
+ *  so an allocation sneaking into update or draw shows up right away.
+ *
+ */
+
+#include <cstdint>
+#include <iosfwd>
+
+enum AllocationPhase : uint32_t {
+	AllocationOther, //anything not in a phase (e.g., loading, or other threads)
+	AllocationEvents, //polling + handling SDL events
+	AllocationUpdate, //Mode::update
+	AllocationDraw, //Mode::draw
+	AllocationPhaseCount
+};
+char const *allocation_phase_name(AllocationPhase phase);
+
+struct AllocationCounts {
+	uint64_t allocations = 0;
+	uint64_t bytes = 0;
+};
+
+//count allocations made by this thread against 'phase' for as long as this object is in scope:
+// (threads that never use an AllocationScope count against AllocationOther)
+struct AllocationScope {
+	AllocationScope(AllocationPhase phase);
+	~AllocationScope();
+	AllocationScope(AllocationScope const &) = delete;
+	AllocationScope &operator=(AllocationScope const &) = delete;
+	AllocationPhase previous;
+};
+
+//allocations so far in the current frame:
+AllocationCounts allocation_frame_counts(AllocationPhase phase);
+//allocations since the program started:
+AllocationCounts allocation_total_counts(AllocationPhase phase);
+
+//maximum allocations per frame for a phase (-1U -- the default -- means no limit):
+// (main.cpp sets a budget of zero for update and draw)
+void set_allocation_budget(AllocationPhase phase, uint32_t allocations);
+
+//call once per frame, from the main loop: checks each phase's counts against its budget,
+// then starts counting the next frame. returns false if any phase was over budget.
+// (pass check_budgets = false to just start counting the next frame, e.g. after a first frame that sizes buffers)
+bool allocation_end_frame(bool check_budgets = true);
+
+//print per-phase totals, worst frames, and budget overruns:
+void allocation_report(std::ostream &out);
@@ -0,0 +1,128 @@
+#include "ArtWatcher.hpp"
+
+#include "TileSheet.hpp"
+
+#include <iostream>
+#include <set>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+#if defined(__linux__)
+
+ArtWatcher::ArtWatcher(std::string const &directory_) : directory(directory_) {
+	watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watch_fd < 0) {
+		std::cerr << "WARNING: not watching '" << directory << "' for art changes (inotify_init1: " << std::strerror(errno) << ")." << std::endl;
+		return;
+	}
+	//IN_CLOSE_WRITE catches editors that write in place, IN_MOVED_TO those that write a temporary file and rename it:
+	if (inotify_add_watch(watch_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		std::cerr << "WARNING: not watching '" << directory << "' for art changes (" << std::strerror(errno) << ")." << std::endl;
+		close(watch_fd);
+		watch_fd = -1;
+		return;
+	}
+	if (pipe2(wake_fds, O_CLOEXEC) != 0) {
+		std::cerr << "WARNING: not watching '" << directory << "' for art changes (pipe2: " << std::strerror(errno) << ")." << std::endl;
+		close(watch_fd);
+		watch_fd = -1;
+		return;
+	}
+
+	thread = std::thread([this](){
+		//inotify events are a header followed by a (padded) name:
+		alignas(inotify_event) char buffer[4096];
+		while (true) {
+			pollfd fds[2];
+			fds[0].fd = watch_fd;
+			fds[0].events = POLLIN;
+			fds[1].fd = wake_fds[0];
+			fds[1].events = POLLIN;
+			if (poll(fds, 2, -1) < 0) {
+				if (errno == EINTR) continue;
+				std::cerr << "WARNING: stopped watching '" << directory << "' for art changes (poll: " << std::strerror(errno) << ")." << std::endl;
+				return;
+			}
+			if (fds[1].revents) return; //destructor wants the thread to stop
+
+			//saving a file can generate several events, so gather up every changed name before decoding:
+			std::set< std::string > changed;
+			while (true) {
+				ssize_t got = read(watch_fd, buffer, sizeof(buffer));
+				if (got <= 0) break;
+				for (char const *at = buffer; at < buffer + got; ) {
+					inotify_event const *event = reinterpret_cast< inotify_event const * >(at);
+					at += sizeof(inotify_event) + event->len;
+					if (event->len == 0) continue;
+					std::string filename(event->name);
+					if (filename.size() <= 4) continue;
+					std::string extension = filename.substr(filename.size() - 4);
+					if (extension == ".png") {
+						changed.insert(filename);
+					} else if (extension == ".txt") {
+						//a sprite sheet's names changed, so reload the sheet:
+						changed.insert(filename.substr(0, filename.size() - 4) + ".png");
+					}
+				}
+			}
+
+			for (auto const &filename : changed) {
+				//a sprite sheet reloads every sprite in it, anything else is one sprite named after the file:
+				// (both load through load_png_cached, which keys on modification time: an edited
+				//  file is decoded again, while a repeat event for a file that hasn't changed is just a lookup)
+				std::string path = directory + "/" + filename;
+				std::vector< Reload > loaded;
+				try {
+					if (is_sprite_sheet(path)) {
+						for (auto &named : load_sprite_sheet(path)) {
+							loaded.emplace_back(Reload{named.first, named.second});
+						}
+					} else {
+						loaded.emplace_back(Reload{filename.substr(0, filename.size() - 4), SpriteBundle::encode_png(path)});
+					}
+				} catch (std::exception const &e) {
+					std::cerr << "WARNING: not reloading art: " << e.what() << std::endl;
+					continue;
+				}
+				std::lock_guard< std::mutex > lock(mutex);
+				for (auto &reload : loaded) {
+					reloads.emplace_back(std::move(reload));
+				}
+			}
+		}
+	});
+}
+
+ArtWatcher::~ArtWatcher() {
+	if (thread.joinable()) {
+		char stop = 0;
+		while (write(wake_fds[1], &stop, 1) < 0 && errno == EINTR) { }
+		thread.join();
+	}
+	if (wake_fds[0] >= 0) close(wake_fds[0]);
+	if (wake_fds[1] >= 0) close(wake_fds[1]);
+	if (watch_fd >= 0) close(watch_fd);
+}
+
+#else //no inotify; never reports changes
+
+ArtWatcher::ArtWatcher(std::string const &directory_) : directory(directory_) {
+}
+
+ArtWatcher::~ArtWatcher() {
+}
+
+#endif
+
+void ArtWatcher::take_reloads(std::vector< Reload > &out) {
+	out.clear(); //(keeps its buffer, which the watcher thread fills next)
+	std::lock_guard< std::mutex > lock(mutex);
+	out.swap(reloads);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+/*
+ * ArtWatcher watches a directory of sprite PNGs and re-encodes any that change,
+ *  so art can be edited while the game is running.
+ *
+ * Sprite sheets (see TileSheet.hpp) reload every sprite in the sheet; any other PNG
+ *  is one sprite, named after the file (as pack-sprites does).
+ *
+ * Changed images are decoded and encoded (see SpriteBundle::encode) on a background
+ *  thread; the main thread just picks up the finished sprites with take_reloads().
+ *
+ * Uses inotify, so only watches on Linux; elsewhere it never reports any reloads.
+ *
+ */
+
+#include "SpriteBundle.hpp"
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct ArtWatcher {
+	//start watching 'directory' for .png files being written or moved in:
+	// (if the directory can't be watched, prints a warning and watching() is false)
+	ArtWatcher(std::string const &directory);
+	~ArtWatcher();
+	ArtWatcher(ArtWatcher const &) = delete;
+	ArtWatcher &operator=(ArtWatcher const &) = delete;
+
+	struct Reload {
+		std::string name; //sprite name (as used by pack-sprites)
+		SpriteBundle::Sprite sprite;
+	};
+
+	//replace 'out' with the sprites re-encoded since the last call (oldest first):
+	// (cheap -- just swaps lists -- so fine to call every frame; reusing the same 'out'
+	//  each time means the two lists trade buffers instead of allocating new ones)
+	void take_reloads(std::vector< Reload > &out);
+
+	bool watching() const { return thread.joinable(); }
+
+	std::string directory;
+
+private:
+	std::mutex mutex; //guards 'reloads'
+	std::vector< Reload > reloads;
+
+	std::thread thread;
+#if defined(__linux__)
+	int watch_fd = -1; //inotify instance
+	int wake_fds[2] = {-1, -1}; //pipe used to stop the thread
+#endif
+};
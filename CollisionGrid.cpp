@@ -0,0 +1,58 @@
+#include "CollisionGrid.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+CollisionGrid::CollisionGrid(glm::uvec2 extent) {
+	cells_size = glm::max(glm::uvec2(1), (extent + glm::uvec2(CellSize - 1)) / uint32_t(CellSize));
+	cells.resize(cells_size.x * cells_size.y);
+}
+
+void CollisionGrid::cell_range(Box const &box, glm::uvec2 *lo, glm::uvec2 *hi) const {
+	//clamp to the grid, so things off the edge land in the edge cells:
+	auto cell = [](float v, uint32_t count) -> uint32_t {
+		float c = std::floor(v / float(CellSize));
+		if (!(c >= 0.0f)) return 0; //(also catches NaN)
+		if (c >= float(count - 1)) return count - 1;
+		return uint32_t(c);
+	};
+	lo->x = cell(box.min.x, cells_size.x);
+	lo->y = cell(box.min.y, cells_size.y);
+	hi->x = cell(box.max.x, cells_size.x);
+	hi->y = cell(box.max.y, cells_size.y);
+}
+
+void CollisionGrid::insert(uint32_t id, Box const &box) {
+	if (id >= boxes.size()) boxes.resize(id + 1);
+	Entry &entry = boxes[id];
+	assert(!entry.in_grid && "object is already in the grid");
+	entry.box = box;
+	entry.in_grid = true;
+
+	glm::uvec2 lo, hi;
+	cell_range(box, &lo, &hi);
+	for (uint32_t y = lo.y; y <= hi.y; ++y) {
+		for (uint32_t x = lo.x; x <= hi.x; ++x) {
+			cells[x + y * cells_size.x].emplace_back(id);
+		}
+	}
+}
+
+void CollisionGrid::remove(uint32_t id) {
+	if (!contains(id)) return;
+	Entry &entry = boxes[id];
+	entry.in_grid = false;
+
+	glm::uvec2 lo, hi;
+	cell_range(entry.box, &lo, &hi);
+	for (uint32_t y = lo.y; y <= hi.y; ++y) {
+		for (uint32_t x = lo.x; x <= hi.x; ++x) {
+			auto &cell = cells[x + y * cells_size.x];
+			auto f = std::find(cell.begin(), cell.end(), id);
+			assert(f != cell.end());
+			*f = cell.back(); //(order within a cell doesn't matter)
+			cell.pop_back();
+		}
+	}
+}
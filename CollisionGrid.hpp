@@ -0,0 +1,81 @@
+#pragma once
+
+/*
+ * CollisionGrid is a uniform-grid broadphase for axis-aligned boxes.
+ *
+ * The world is divided into square cells; each object is listed in every cell its box touches,
+ *  so a query only looks at objects in the cells around the query box.
+ *
+ * Objects are identified by small integer ids (e.g., indices into a game's own object list),
+ *  and can be inserted and removed one at a time as they appear and disappear.
+ *
+ */
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct CollisionGrid {
+	enum : uint32_t { CellSize = 16 }; //in pixels; the size of a PPU466 metasprite
+
+	//grid covering [0,extent) -- objects outside it are kept in the edge cells, so are still found:
+	CollisionGrid(glm::uvec2 extent);
+
+	//boxes are closed: [min,max], so boxes that just touch overlap.
+	struct Box {
+		glm::vec2 min, max;
+	};
+
+	//add object 'id' with box 'box' (id must not already be in the grid):
+	void insert(uint32_t id, Box const &box);
+	//remove object 'id' (does nothing if it isn't in the grid):
+	void remove(uint32_t id);
+	//is object 'id' in the grid?
+	bool contains(uint32_t id) const { return id < boxes.size() && boxes[id].in_grid; }
+
+	//calls fn(id) once for each object whose box overlaps 'box':
+	// (ids are reported in no particular order; don't insert or remove from inside fn)
+	template< typename F >
+	void query(Box const &box, F const &fn);
+
+	glm::uvec2 cells_size; //number of cells in x and y
+
+private:
+	struct Entry {
+		Box box;
+		bool in_grid = false;
+		uint32_t stamp = 0; //last query that reported this object
+	};
+	std::vector< Entry > boxes; //by id
+	std::vector< std::vector< uint32_t > > cells; //ids, by cell (x + y * cells_size.x)
+	uint32_t query_stamp = 0;
+
+	//range of cells (inclusive) touched by a box:
+	void cell_range(Box const &box, glm::uvec2 *lo, glm::uvec2 *hi) const;
+};
+
+template< typename F >
+void CollisionGrid::query(Box const &box, F const &fn) {
+	//stamps make sure an object in several of the cells is only reported once:
+	query_stamp += 1;
+	if (query_stamp == 0) { //wrapped around, so old stamps could match
+		for (auto &entry : boxes) entry.stamp = 0;
+		query_stamp = 1;
+	}
+
+	glm::uvec2 lo, hi;
+	cell_range(box, &lo, &hi);
+	for (uint32_t y = lo.y; y <= hi.y; ++y) {
+		for (uint32_t x = lo.x; x <= hi.x; ++x) {
+			for (uint32_t id : cells[x + y * cells_size.x]) {
+				Entry &entry = boxes[id];
+				if (entry.stamp == query_stamp) continue;
+				entry.stamp = query_stamp;
+				if (entry.box.min.x > box.max.x || entry.box.max.x < box.min.x
+				 || entry.box.min.y > box.max.y || entry.box.max.y < box.min.y) continue;
+				fn(id);
+			}
+		}
+	}
+}
@@ -0,0 +1,58 @@
+#include "EntityStore.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+void EntityStore::reserve(uint32_t count) {
+	x.reserve(count);
+	y.reserve(count);
+	type.reserve(count);
+	palette_index.reserve(count);
+	tile_index.reserve(count);
+	sprite_index.reserve(count);
+	consumed_bits.reserve((count + 63) / 64);
+}
+
+uint32_t EntityStore::add(int16_t x_, int16_t y_, uint8_t type_, uint8_t palette_index_, uint8_t tile_index_, uint8_t sprite_index_) {
+	uint32_t i = size();
+	x.emplace_back(x_);
+	y.emplace_back(y_);
+	type.emplace_back(type_);
+	palette_index.emplace_back(palette_index_);
+	tile_index.emplace_back(tile_index_);
+	sprite_index.emplace_back(sprite_index_);
+	if (i / 64 >= consumed_bits.size()) consumed_bits.emplace_back(0);
+	return i;
+}
+
+void EntityStore::set_consumed(uint32_t i, bool consumed) {
+	assert(i < size());
+	uint64_t bit = uint64_t(1) << (i % 64);
+	if (consumed) consumed_bits[i / 64] |= bit;
+	else consumed_bits[i / 64] &= ~bit;
+}
+
+void EntityStore::set_consumed(uint32_t begin, uint32_t end, bool consumed) {
+	assert(begin <= end && end <= size());
+	while (begin < end) {
+		//bits [begin, word_end) of this word:
+		uint32_t word_end = std::min((begin / 64 + 1) * 64, end);
+		uint32_t count = word_end - begin;
+		uint64_t mask = (count == 64 ? ~uint64_t(0) : ((uint64_t(1) << count) - 1)) << (begin % 64);
+		if (consumed) consumed_bits[begin / 64] |= mask;
+		else consumed_bits[begin / 64] &= ~mask;
+		begin = word_end;
+	}
+}
+
+void EntityStore::emit_sprites(PPU466 &ppu, uint32_t begin, uint32_t end, uint8_t attribute_bits) const {
+	assert(begin <= end && end <= size());
+	for (uint32_t i = begin; i < end; ++i) {
+		if (sprite_index[i] == NoSprite) continue;
+		PPU466::Sprite &sprite = ppu.sprites[sprite_index[i]];
+		sprite.x = uint8_t(x[i]);
+		sprite.y = consumed(i) ? uint8_t(PPU466::ScreenHeight) : uint8_t(y[i]); //(y past the bottom of the screen hides the sprite)
+		sprite.index = tile_index[i];
+		sprite.attributes = uint8_t(palette_index[i] | attribute_bits);
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+/*
+ * EntityStore keeps a scene's objects as parallel arrays ("structure of arrays"):
+ *  entity i is x[i], y[i], type[i], and so on.
+ *
+ * Loops that only need a field or two (e.g., positions for collision, or the consumed bits)
+ *  walk just those arrays, which stay small and contiguous even with many thousands of entities.
+ *
+ */
+
+#include "PPU466.hpp"
+
+#include <cstdint>
+#include <vector>
+
+struct EntityStore {
+	enum : uint8_t { NoSprite = 0xff }; //sprite_index of entities that aren't drawn with a PPU sprite
+
+	//per-entity data:
+	std::vector< int16_t > x, y; //lower left corner of the entity's 16x16 box, in pixels
+	std::vector< uint8_t > type; //meaning is up to the game
+	std::vector< uint8_t > palette_index; //PPU palette to draw with
+	std::vector< uint8_t > tile_index; //PPU tile (the lower left tile of a metasprite)
+	std::vector< uint8_t > sprite_index; //PPU sprite slot to draw into (or NoSprite)
+	std::vector< uint64_t > consumed_bits; //one bit per entity
+
+	uint32_t size() const { return uint32_t(x.size()); }
+	void reserve(uint32_t count);
+
+	//add an entity (not consumed); returns its index:
+	uint32_t add(int16_t x, int16_t y, uint8_t type, uint8_t palette_index, uint8_t tile_index, uint8_t sprite_index);
+
+	bool consumed(uint32_t i) const { return (consumed_bits[i / 64] >> (i % 64)) & 1; }
+	void set_consumed(uint32_t i, bool consumed);
+	//set or clear the consumed bits of entities [begin,end) a word at a time:
+	void set_consumed(uint32_t begin, uint32_t end, bool consumed);
+
+	//write entities [begin,end) into their PPU sprites:
+	// position, tile, and attributes (palette_index | attribute_bits); consumed entities are moved off screen.
+	void emit_sprites(PPU466 &ppu, uint32_t begin, uint32_t end, uint8_t attribute_bits) const;
+};
@@ -0,0 +1,172 @@
+#include "FrameTimer.hpp"
+
+#include "PPU466.hpp"
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+uint32_t RollingHistogram::bucket_of(uint64_t nanoseconds) {
+	//small samples get one bucket per value:
+	if (nanoseconds < SubBuckets) return uint32_t(nanoseconds);
+	//otherwise: which power of two, then which linear step within it:
+	uint32_t octave = SubBits;
+	while (octave < 63 && (nanoseconds >> (octave + 1)) != 0) ++octave;
+	if (octave > MaxOctave) return BucketCount - 1;
+	uint32_t sub = uint32_t(nanoseconds >> (octave - SubBits)) & (SubBuckets - 1);
+	return (octave - SubBits + 1) * SubBuckets + sub;
+}
+
+uint64_t RollingHistogram::bucket_start(uint32_t bucket) {
+	if (bucket < SubBuckets) return bucket;
+	uint32_t octave = bucket / SubBuckets + SubBits - 1;
+	uint32_t sub = bucket % SubBuckets;
+	return uint64_t(SubBuckets + sub) << (octave - SubBits);
+}
+
+void RollingHistogram::add(uint64_t nanoseconds) {
+	uint32_t gen = current.load(std::memory_order_relaxed);
+	if (counts[gen].load(std::memory_order_relaxed) >= GenerationSamples) {
+		//current generation is full; clear out the older one and switch to it:
+		gen ^= 1;
+		for (auto &bucket : buckets[gen]) {
+			bucket.store(0, std::memory_order_relaxed);
+		}
+		maxes[gen].store(0, std::memory_order_relaxed);
+		counts[gen].store(0, std::memory_order_relaxed);
+		current.store(gen, std::memory_order_release);
+	}
+	buckets[gen][bucket_of(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+	if (nanoseconds > maxes[gen].load(std::memory_order_relaxed)) {
+		maxes[gen].store(nanoseconds, std::memory_order_relaxed);
+	}
+	counts[gen].fetch_add(1, std::memory_order_release);
+}
+
+RollingHistogram::Summary RollingHistogram::summarize() const {
+	Summary ret;
+
+	//snapshot both generations (on the stack, so summarizing never allocates):
+	// (the writer may add samples or retire a generation while we read; that only mixes in newer samples)
+	std::array< uint32_t, BucketCount > snapshot;
+	uint32_t n = 0;
+	for (uint32_t b = 0; b < BucketCount; ++b) {
+		snapshot[b] = buckets[0][b].load(std::memory_order_acquire) + buckets[1][b].load(std::memory_order_acquire);
+		n += snapshot[b];
+	}
+	if (n == 0) return ret;
+	uint64_t max = std::max(maxes[0].load(std::memory_order_relaxed), maxes[1].load(std::memory_order_relaxed));
+
+	//nearest-rank percentiles, reported as the end of the bucket holding that rank (but never past max):
+	auto percentile = [&](double p) {
+		uint32_t rank = std::min(n, uint32_t(std::max(1.0, p * n + 0.5)));
+		uint32_t seen = 0;
+		for (uint32_t b = 0; b < BucketCount; ++b) {
+			seen += snapshot[b];
+			if (seen >= rank) {
+				uint64_t end = (b + 1 < BucketCount ? bucket_start(b + 1) - 1 : max);
+				return double(std::min(end, max)) * 1e-9;
+			}
+		}
+		return double(max) * 1e-9;
+	};
+	ret.samples = n;
+	ret.p50 = percentile(0.50);
+	ret.p95 = percentile(0.95);
+	ret.p99 = percentile(0.99);
+	ret.max = double(max) * 1e-9;
+	return ret;
+}
+
+FrameTimer::FrameTimer() {
+	queries.fill(0);
+	query_pending.fill(false);
+}
+
+FrameTimer::~FrameTimer() {
+	//release_gl() should have been called while the context was current;
+	// if it wasn't, leak the queries rather than call GL without a context.
+}
+
+char const *FrameTimer::phase_name(Phase phase) {
+	switch (phase) {
+		case Events: return "events";
+		case Update: return "update";
+		case Draw: return "draw (cpu)";
+		case GPU: return "draw (gpu)";
+		case Swap: return "swap";
+		default: return "?";
+	}
+}
+
+void FrameTimer::collect(uint32_t slot) {
+	if (!query_pending[slot]) return;
+	GLint available = GL_FALSE;
+	glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (available == GL_FALSE) return;
+	GLuint64 elapsed = 0;
+	glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed);
+	phases[GPU].add(uint64_t(elapsed));
+	query_pending[slot] = false;
+}
+
+void FrameTimer::gpu_begin() {
+	if (queries[0] == 0) {
+		glGenQueries(GLsizei(queries.size()), queries.data());
+	}
+	uint32_t slot = next_query;
+	collect(slot);
+	//if the result from QueryRing frames ago still isn't ready, reusing the query throws it away:
+	if (query_pending[slot]) {
+		++gpu_dropped;
+		query_pending[slot] = false;
+	}
+	glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+}
+
+void FrameTimer::gpu_end() {
+	glEndQuery(GL_TIME_ELAPSED);
+	query_pending[next_query] = true;
+	next_query = (next_query + 1) % QueryRing;
+	GL_ERRORS();
+}
+
+void FrameTimer::report(std::ostream &out) {
+	//pick up any finished GPU timings first:
+	for (uint32_t slot = 0; slot < QueryRing; ++slot) {
+		collect(slot);
+	}
+
+	out << "Frame timing (most recent " << RollingHistogram::GenerationSamples << "-" << 2 * RollingHistogram::GenerationSamples << " frames, in ms):\n";
+	out << "  " << std::left << std::setw(12) << "phase" << std::right
+		<< std::setw(10) << "p50" << std::setw(10) << "p95" << std::setw(10) << "p99" << std::setw(10) << "max"
+		<< std::setw(10) << "samples" << "\n";
+	std::ios::fmtflags old_flags = out.flags();
+	std::streamsize old_precision = out.precision();
+	out << std::fixed << std::setprecision(3);
+	for (uint32_t p = 0; p < PhaseCount; ++p) {
+		RollingHistogram::Summary s = phases[p].summarize();
+		out << "  " << std::left << std::setw(12) << phase_name(Phase(p)) << std::right
+			<< std::setw(10) << s.p50 * 1e3 << std::setw(10) << s.p95 * 1e3 << std::setw(10) << s.p99 * 1e3 << std::setw(10) << s.max * 1e3
+			<< std::setw(10) << s.samples << "\n";
+	}
+	out.flags(old_flags);
+	out.precision(old_precision);
+	if (gpu_dropped) {
+		out << "  (" << gpu_dropped << " frames' gpu timers were still in flight when reused)\n";
+	}
+	//how often PPU466::draw had to wait for the GPU to free up a region of its stream buffer:
+	PPU466::StreamStats const &stream = PPU466::stream_stats();
+	out << "  ppu stream: " << stream.frames << " frames, " << stream.fence_waits << " waited on a fence ("
+		<< stream.fence_wait_seconds * 1e3 << " ms total)\n";
+	out.flush();
+}
+
+void FrameTimer::release_gl() {
+	if (queries[0] != 0) {
+		glDeleteQueries(GLsizei(queries.size()), queries.data());
+		queries.fill(0);
+		query_pending.fill(false);
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+/*
+ * FrameTimer -- per-phase frame timing for the main loop.
+ *
+ * Each phase of a frame (event polling, update, draw, GPU time, swap) keeps
+ *  a rolling log-scale histogram of its recent samples; report() prints p50/p95/p99.
+ *
+ * GPU time is measured with GL_TIME_ELAPSED queries around the draw call.
+ *  Results are read a few frames later (when available) so timing never stalls the pipeline.
+ *
+ */
+
+#include "GL.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iosfwd>
+
+//A histogram of recent samples (in nanoseconds) with fixed log-scale buckets:
+// each power of two is split into SubBuckets linear steps, so a percentile is off by at most 1/SubBuckets (~6%).
+// add() is lock-free and meant for one writer (the main loop);
+// summarize() may be called from any thread; it walks the buckets (no allocation, no sorting).
+//"rolling" comes from two generations of counters: once the current one holds GenerationSamples samples,
+// the older one is cleared and takes over, so summaries cover the last 1x-2x GenerationSamples samples.
+struct RollingHistogram {
+	enum : uint32_t {
+		GenerationSamples = 1024,
+		SubBits = 4,
+		SubBuckets = 1 << SubBits,
+		MaxOctave = 39, //samples of 2^40 ns (~18 minutes) or more land in the last bucket
+		BucketCount = (MaxOctave - SubBits + 2) * SubBuckets,
+	};
+	std::array< std::array< std::atomic< uint32_t >, BucketCount >, 2 > buckets{};
+	std::array< std::atomic< uint32_t >, 2 > counts{};
+	std::array< std::atomic< uint64_t >, 2 > maxes{};
+	std::atomic< uint32_t > current{0}; //generation add() writes to
+
+	//which bucket a sample goes in, and the smallest sample that lands in a bucket:
+	static uint32_t bucket_of(uint64_t nanoseconds);
+	static uint64_t bucket_start(uint32_t bucket);
+
+	void add(uint64_t nanoseconds);
+
+	struct Summary {
+		uint32_t samples = 0; //number of samples in the window
+		double p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0; //in seconds
+	};
+	Summary summarize() const;
+};
+
+struct FrameTimer {
+	FrameTimer();
+	~FrameTimer();
+
+	enum Phase : uint32_t {
+		Events, //polling + handling SDL events
+		Update, //Mode::update
+		Draw, //Mode::draw (CPU time to issue commands)
+		GPU, //GPU time to execute Mode::draw's commands
+		Swap, //SDL_GL_SwapWindow
+		PhaseCount
+	};
+	static char const *phase_name(Phase phase);
+
+	std::array< RollingHistogram, PhaseCount > phases;
+
+	//time a CPU phase for as long as this object is in scope:
+	struct Scope {
+		Scope(FrameTimer &timer_, Phase phase_) : timer(timer_), phase(phase_), start(std::chrono::steady_clock::now()) { }
+		~Scope() {
+			timer.phases[phase].add(uint64_t(std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now() - start).count()));
+		}
+		FrameTimer &timer;
+		Phase phase;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	//bracket GPU work with these (needs a current GL context):
+	void gpu_begin();
+	void gpu_end();
+
+	//GPU timers still in flight when a result was needed (these frames go unmeasured):
+	uint64_t gpu_dropped = 0;
+
+	//print p50/p95/p99 of each phase (plus PPU466's stream buffer fence waits):
+	void report(std::ostream &out);
+
+	//call while the GL context is still current:
+	void release_gl();
+
+private:
+	//a small ring of queries so results can be read a few frames late:
+	enum : uint32_t { QueryRing = 4 };
+	std::array< GLuint, QueryRing > queries;
+	std::array< bool, QueryRing > query_pending;
+	uint32_t next_query = 0;
+	//record the result of the query in 'slot' if it is ready (never waits for the GPU):
+	void collect(uint32_t slot);
+};
@@ -1,20 +1,36 @@
 #include "Load.hpp"
 
 #include <array>
-#include <list>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <string>
 #include <cassert>
 
 namespace {
-	std::array< std::list< std::function< void() > >, MaxLoadTag > &get_load_lists() {
-		static std::array< std::list< std::function< void() > >, MaxLoadTag > load_lists;
-		return load_lists;
+	struct LoadFunction {
+		LoadTag tag;
+		std::function< void() > fn;
+		LoadThread thread;
+		//dependencies are kept as pointers and resolved to ids in call_load_functions(),
+		// since (across files) a Load<> may be constructed before the Load<>s it depends on:
+		std::vector< LoadDependency const * > after;
+	};
+
+	std::vector< LoadFunction > &get_load_functions() {
+		static std::vector< LoadFunction > load_functions;
+		return load_functions;
 	}
 }
 
-void add_load_function(LoadTag tag, std::function< void() > const &fn) {
-	auto &load_lists = get_load_lists();
-	assert(tag < load_lists.size());
-	load_lists[tag].emplace_back(fn);
+void add_load_function(LoadTag tag, std::function< void() > const &fn, LoadThread thread, std::vector< LoadDependency const * > const &after, LoadDependency *registered) {
+	assert(tag < MaxLoadTag);
+	auto &load_functions = get_load_functions();
+	if (registered) registered->load_id = uint32_t(load_functions.size());
+	load_functions.emplace_back(LoadFunction{tag, fn, thread, after});
 }
 
 void call_load_functions() {
@@ -22,11 +38,125 @@ void call_load_functions() {
 	assert(!has_been_called && "call_load_functions should only be called *once*");
 	has_been_called = true;
 
-	auto &load_lists = get_load_lists();
-	for (auto &fn_list : load_lists) {
-		while (!fn_list.empty()) {
-			(*fn_list.begin())(); //call first function in the list
-			fn_list.pop_front(); //remove from list
+	auto &load_functions = get_load_functions();
+
+	//resolve dependencies into a count of unfinished dependencies and a list of dependents per function:
+	std::vector< uint32_t > waiting_on(load_functions.size(), 0);
+	std::vector< std::vector< uint32_t > > dependents(load_functions.size());
+	for (uint32_t id = 0; id < load_functions.size(); ++id) {
+		for (LoadDependency const *dep : load_functions[id].after) {
+			assert(dep);
+			if (dep->load_id >= load_functions.size()) {
+				throw std::runtime_error("Loading function depends on something that was never registered.");
+			}
+			if (load_functions[dep->load_id].tag > load_functions[id].tag) {
+				throw std::runtime_error("Loading function depends on a loading function with a later tag.");
+			}
+			//dependencies on earlier tags are already satisfied by the tag barrier:
+			if (load_functions[dep->load_id].tag < load_functions[id].tag) continue;
+			waiting_on[id] += 1;
+			dependents[dep->load_id].emplace_back(id);
 		}
 	}
+
+	//shared state for the main thread and workers:
+	std::mutex mutex;
+	std::condition_variable cv; //notified whenever a function is queued or finishes
+	std::deque< uint32_t > main_queue; //ready functions that need the main thread
+	std::deque< uint32_t > any_queue; //ready functions that can run anywhere
+	uint32_t remaining = 0; //functions of the current tag not yet finished
+	uint32_t running = 0; //functions of the current tag being called right now
+	std::exception_ptr failure; //first exception thrown by a loading function
+	bool quit = false;
+
+	auto enqueue = [&](uint32_t id) {
+		if (load_functions[id].thread == LoadOnMainThread) main_queue.emplace_back(id);
+		else any_queue.emplace_back(id);
+	};
+
+	//call function 'id' (with mutex locked on entry and exit):
+	auto call = [&](std::unique_lock< std::mutex > &lock, uint32_t id) {
+		running += 1;
+		lock.unlock();
+		std::exception_ptr thrown;
+		try {
+			load_functions[id].fn();
+		} catch (...) {
+			thrown = std::current_exception();
+		}
+		load_functions[id].fn = nullptr; //release anything captured
+		lock.lock();
+		running -= 1;
+		remaining -= 1;
+		if (thrown) {
+			if (!failure) failure = thrown;
+		} else {
+			for (uint32_t d : dependents[id]) {
+				assert(waiting_on[d] > 0);
+				waiting_on[d] -= 1;
+				if (waiting_on[d] == 0) enqueue(d);
+			}
+		}
+		cv.notify_all();
+	};
+
+	//workers call LoadOnAnyThread functions; the main thread calls those too when it has nothing else to do:
+	uint32_t worker_count = std::thread::hardware_concurrency();
+	if (worker_count > 0) worker_count -= 1; //(the main thread is also working)
+	std::vector< std::thread > workers;
+	workers.reserve(worker_count);
+	for (uint32_t i = 0; i < worker_count; ++i) {
+		workers.emplace_back([&](){
+			std::unique_lock< std::mutex > lock(mutex);
+			while (true) {
+				cv.wait(lock, [&](){ return quit || (!failure && !any_queue.empty()); });
+				if (quit) break;
+				uint32_t id = any_queue.front();
+				any_queue.pop_front();
+				call(lock, id);
+			}
+		});
+	}
+
+	{ //tags act as barriers -- each tag finishes before the next starts:
+		std::unique_lock< std::mutex > lock(mutex);
+		for (uint32_t tag = 0; tag < MaxLoadTag && !failure; ++tag) {
+			assert(running == 0 && main_queue.empty() && any_queue.empty());
+			for (uint32_t id = 0; id < load_functions.size(); ++id) {
+				if (load_functions[id].tag != tag) continue;
+				remaining += 1;
+				if (waiting_on[id] == 0) enqueue(id);
+			}
+			cv.notify_all();
+
+			while (remaining > 0 && !failure) {
+				if (!main_queue.empty()) {
+					uint32_t id = main_queue.front();
+					main_queue.pop_front();
+					call(lock, id);
+				} else if (!any_queue.empty()) {
+					uint32_t id = any_queue.front();
+					any_queue.pop_front();
+					call(lock, id);
+				} else if (running > 0) {
+					cv.wait(lock);
+				} else {
+					failure = std::make_exception_ptr(std::runtime_error(
+						"Loading functions have a dependency cycle (" + std::to_string(remaining) + " can't be called)."));
+				}
+			}
+			//on failure, wait for functions that are already running:
+			while (running > 0) cv.wait(lock);
+		}
+		quit = true;
+		cv.notify_all();
+	}
+
+	for (auto &worker : workers) {
+		worker.join();
+	}
+
+	load_functions.clear();
+
+	if (failure) std::rethrow_exception(failure);
 }
@@ -20,10 +20,27 @@
  * These functions are grouped by 'tags', which allow some sequencing of calls.
  * (particularly, this is useful for loading large data blobs [e.g. Meshes] before looking up individual elements within them.)
  *
+ * Loading functions that don't need OpenGL (e.g., reading and decoding files) can be marked
+ *  LoadOnAnyThread, which lets them run in parallel on a pool of worker threads.
+ * Functions can also list other Load<>s they depend on; they'll only be called once those are loaded:
+ *
+ * Load< Image > hero_image(LoadTagDefault, []() -> const Image * {
+ *     return new Image(data_path("hero.png"));
+ * }, LoadOnAnyThread);
+ *
+ * Load< Texture > hero_texture(LoadTagDefault, []() -> const Texture * {
+ *     return new Texture(*hero_image); //uses OpenGL, so runs on the main thread
+ * }, LoadOnMainThread, { &hero_image });
+ *
+ * Tags still act as barriers: every function of one tag finishes before any function of the next tag starts.
+ *
  */
 
 #include <functional>
 #include <stdexcept>
+#include <initializer_list>
+#include <vector>
+#include <cstdint>
 
 enum LoadTag : uint32_t {
 	LoadTagEarly,
@@ -32,13 +49,29 @@ enum LoadTag : uint32_t {
 	MaxLoadTag //<-- just used to track # of load tags
 };
 
+//Where a loading function may run:
+enum LoadThread : uint32_t {
+	LoadOnMainThread, //needs the OpenGL context (the default)
+	LoadOnAnyThread, //CPU-only; may run on a worker thread, in parallel with other loading functions
+};
+
+//Something registered with add_load_function that other loading functions can depend on:
+// (Load<> objects are LoadDependencies)
+struct LoadDependency {
+	uint32_t load_id = -1U; //set by add_load_function
+};
+
 //Add a function to an internal list of loading functions:
 // (only call *before* "call_load_functions()")
-void add_load_function(LoadTag tag, std::function< void() > const &fn);
+// 'after' lists loading functions (of this or an earlier tag) that must finish before this one is called.
+// if 'registered' is given, its load_id is set so that later loading functions can depend on this one.
+void add_load_function(LoadTag tag, std::function< void() > const &fn,
+	LoadThread thread = LoadOnMainThread, std::vector< LoadDependency const * > const &after = {},
+	LoadDependency *registered = nullptr);
 
 //Call all loading functions:
-// (loading functions may throw exceptions if they fail.)
-// (only call *once*)
+// (loading functions may throw exceptions if they fail; the first exception is re-thrown here.)
+// (only call *once*, from the main thread)
 void call_load_functions();
 
 
@@ -47,15 +80,16 @@ template< typename T >
 T const *new_T() { return new T; }
 
 template< typename T >
-struct Load {
+struct Load : LoadDependency {
 	//Constructing a Load< T > adds the passed function to the list of functions to call:
-	Load(LoadTag tag, const std::function< T const *() > &load_fn = new_T< T >) : value(nullptr) {
+	Load(LoadTag tag, const std::function< T const *() > &load_fn = new_T< T >,
+		LoadThread thread = LoadOnMainThread, std::initializer_list< LoadDependency const * > after = {}) : value(nullptr) {
 		add_load_function(tag, [this,load_fn](){
 			this->value = load_fn();
 			if (!(this->value)) {
 				throw std::runtime_error("Loading failed.");
 			}
-		});
+		}, thread, after, this);
 	}
 
 	//Make a "Load< T >" behave like a "T const *":
@@ -71,11 +105,10 @@ struct Load {
 //Specialization:
 //Load< void > just calls a function:
 template< >
-struct Load< void > {
+struct Load< void > : LoadDependency {
 	//Constructing a Load< T > adds the passed function to the list of functions to call:
-	Load( LoadTag tag, const std::function< void() > &load_fn) {
-		add_load_function(tag, load_fn);
+	Load( LoadTag tag, const std::function< void() > &load_fn,
+		LoadThread thread = LoadOnMainThread, std::initializer_list< LoadDependency const * > after = {}) {
+		add_load_function(tag, load_fn, thread, after, this);
 	}
 };
-
-
@@ -13,13 +13,22 @@ struct Mode : std::enable_shared_from_this< Mode > {
 	//The function should return 'true' if it handled the event.
 	virtual bool handle_event(SDL_Event const &, glm::uvec2 const &window_size) { return false; }
 
-	//update is called at the start of a new frame, after events are handled:
-	// 'elapsed' is time in seconds since the last call to 'update'
+	//update advances the simulation by one fixed step, and is called after events are handled:
+	// 'elapsed' is always 1 / update_rate seconds; the main loop calls update as many times
+	// as needed to keep up with real time (so zero or several times per frame)
 	virtual void update(float elapsed) { }
 
 	//draw is called after update:
+	// real time is usually part way between the last step and the next one, so draw can
+	// interpolate between the previous and current states using 'update_alpha':
 	virtual void draw(glm::uvec2 const &drawable_size) = 0;
 
+	//fraction (0 to 1) of a step that has passed since the last update (set by the main loop before draw):
+	float update_alpha = 1.0f;
+
+	//simulation steps per second:
+	static float update_rate;
+
 	//Mode::current is the Mode to which events are dispatched.
 	// use 'set_current' to change the current Mode (e.g., to switch to a menu)
 	static std::shared_ptr< Mode > current;
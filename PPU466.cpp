@@ -7,7 +7,10 @@
 
 #include <glm/gtc/type_ptr.hpp>
 
-#include <vector>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <cstddef>
 
 //In order to implement the PPU466 on modern graphics hardware, a fancy, special purpose tile-drawing shader is used:
 struct PPUTileProgram {
@@ -16,13 +19,12 @@ struct PPUTileProgram {
 
 	GLuint program = 0;
 
-	//Attribute (per-vertex variable) locations:
-	GLuint Position_vec2 = -1U;
-	GLuint TileCoord_ivec2 = -1U;
-	GLuint Palette_int = -1U;
+	//Attribute (per-instance variable) locations:
+	GLuint Sprite_uvec4 = -1U; //a PPU466::Sprite record -- (x, y, index, attributes)
 
 	//Uniform (per-invocation variable) locations:
 	GLuint OBJECT_TO_CLIP_mat4 = -1U;
+	GLuint PRIORITY_uint = -1U; //only sprites with this priority bit are drawn
 
 	//Textures bindings:
 	//TEXTURE0 - the tile table (as a 128x128 R8UI texture)
@@ -32,61 +34,91 @@ struct PPUTileProgram {
 //Initialize tile program and associated buffers:
 Load< PPUTileProgram > tile_program(LoadTagEarly); //will 'new PPUTileProgram()' by default
 
+//The background layer is drawn by a second shader that does the tilemap lookup per-fragment in a single screen-sized quad:
+struct PPUBackgroundProgram {
+	PPUBackgroundProgram();
+	~PPUBackgroundProgram();
+
+	GLuint program = 0;
+
+	//No attributes -- the quad is generated from gl_VertexID.
+
+	//Uniform (per-invocation variable) locations:
+	GLuint OBJECT_TO_CLIP_mat4 = -1U;
+	GLuint BACKGROUND_POSITION_ivec2 = -1U;
+
+	//Textures bindings:
+	//TEXTURE0 - the tile table (as a 128x128 R8UI texture)
+	//TEXTURE1 - the palette table (as a 4x8 RGBA8 texture)
+	//TEXTURE2 - the background (as a 64x60 R16UI texture)
+};
+
+Load< PPUBackgroundProgram > background_program(LoadTagEarly);
+
 //PPU data is streamed to the GPU (read: uploaded 'just in time') using a few buffers:
 struct PPUDataStream {
 	PPUDataStream();
 	~PPUDataStream();
 
-	//vertex format for convenience:
-	struct Vertex {
-		Vertex(glm::ivec2 const &Position_, glm::ivec2 const &TileCoord_, int32_t const &Palette_)
-			: Position(Position_), TileCoord(TileCoord_), Palette(Palette_) { }
-		//I generally make class members lowercase, but I make an exception here because
-		// I use uppercase for vertex attributes in shader programs and want to match.
-		glm::ivec2 Position;
-		glm::ivec2 TileCoord;
-		int32_t Palette;
+	//Per-frame data (palettes, background, sprites) is written straight into a mapped ring buffer:
+	// each frame uses the next of StreamRegions regions, and a fence marks when the GPU is done with a region.
+	// the CPU only has to wait if it gets StreamRegions frames ahead of the GPU.
+	enum : uint32_t { StreamRegions = 3 };
+
+	//layout of one region:
+	struct Region {
+		decltype(PPU466::palette_table) palette_table;
+		decltype(PPU466::background) background;
+		decltype(PPU466::sprites) sprites;
 	};
+	//regions are placed at a generously-aligned stride:
+	enum : uint32_t { RegionStride = (sizeof(Region) + 255) / 256 * 256 };
 
-	//vertex buffer that will store data stream:
-	GLuint vertex_buffer = 0;
+	//buffer that holds the ring of regions:
+	GLuint stream_buffer = 0;
 
-	//vertex array object that maps tile program attributes to vertex storage:
-	GLuint vertex_buffer_for_tile_program = 0;
+	//region to write next, and fences marking the last GPU use of each region:
+	// ('mutable' because draw() -- a const function -- advances these)
+	mutable uint32_t next_region = 0;
+	mutable std::array< GLsync, StreamRegions > region_fences;
+
+	//vertex array objects that map tile program attributes to the sprite list in each region:
+	// (each sprite is one instance)
+	std::array< GLuint, StreamRegions > sprites_for_tile_program;
 
 	//texture object that will store tile table:
+	// (shared by every PPU466 -- build() notices when a different PPU466's tiles are needed)
 	GLuint tile_tex = 0;
 
 	//texture object that will store palette table:
 	GLuint palette_tex = 0;
+
+	//texture object that will store the background:
+	GLuint background_tex = 0;
+
+	//vertex array object with no attributes (used when drawing the background):
+	GLuint empty_vao = 0;
 };
 
 Load< PPUDataStream > data_stream(LoadTagDefault);
 
-//-------------------------------------------------------------------
+//counters for PPU466::stream_stats():
+static PPU466::StreamStats stream_stats_;
 
-PPU466::PPU466() {
-	for (auto &palette : palette_table) {
-		palette[0] = glm::u8vec4(0x00, 0x00, 0x00, 0x00);
-		palette[1] = glm::u8vec4(0x44, 0x44, 0x44, 0xff);
-		palette[2] = glm::u8vec4(0x99, 0x99, 0x99, 0xff);
-		palette[3] = glm::u8vec4(0xff, 0xff, 0xff, 0xff);
-	}
+PPU466::StreamStats const &PPU466::stream_stats() {
+	return stream_stats_;
+}
 
-	for (auto &tile : tile_table) {
-		tile.bit0 = { 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0 };
-		tile.bit1 = { 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff };
-	}
+//-------------------------------------------------------------------
 
-	for (uint32_t i = 0; i < background.size(); ++i) {
-		background[i] = int16_t(
-			  (i % 8) << 8 //cycle through all palettes
-			| (i % palette_table.size()) //cycle through all tiles
-		);
-	}
+void PPU466::draw(glm::uvec2 const &drawable_size) const {
+	//one FrameData is re-used for every draw() call:
+	static FrameData frame;
+	build(frame);
+	submit(frame, drawable_size);
 }
 
-void PPU466::draw(glm::uvec2 const &drawable_size) const {
+void PPU466::submit(FrameData const &frame, glm::uvec2 const &drawable_size) {
 	//this code does screen scaling by manipulating the viewport, so save old values:
 	GLint old_viewport[4];
 	glGetIntegerv(GL_VIEWPORT, old_viewport);
@@ -96,9 +128,9 @@ void PPU466::draw(glm::uvec2 const &drawable_size) const {
 
 	//background gets background color:
 	glClearColor(
-		background_color.r / 255.0f, 
-		background_color.g / 255.0f, 
-		background_color.b / 255.0f,
+		frame.background_color.r / 255.0f, 
+		frame.background_color.g / 255.0f, 
+		frame.background_color.b / 255.0f,
 		1.0f
 	);
 	glClear(GL_COLOR_BUFFER_BIT);
@@ -120,123 +152,95 @@ void PPU466::draw(glm::uvec2 const &drawable_size) const {
 		glViewport(lower_left.x, lower_left.y, scale * ScreenWidth, scale * ScreenHeight);
 	}
 
-	//build triangle strip representing background and sprites:
-
-	constexpr uint32_t TristripSize = uint32_t(6 * (BackgroundWidth * BackgroundHeight + decltype(sprites)().size()));
-	std::vector< PPUDataStream::Vertex > triangle_strip;
-	triangle_strip.reserve(TristripSize);
-
-	//helper to put a single tile somewhere on the screen:
-	auto draw_tile = [&triangle_strip](glm::ivec2 const &lower_left, uint8_t tile_index, uint8_t palette_index){
-		//convert tile index to lower-left pixel coordinate in tile image:
-		glm::ivec2 tile_coord = glm::ivec2((tile_index % 16)*8, (tile_index / 16)*8);
-
-		//build a quad as a (very short) triangle strip that starts and ends with degenerate triangles:
-		triangle_strip.emplace_back(glm::ivec2(lower_left.x+0, lower_left.y+0), glm::ivec2(tile_coord.x+0, tile_coord.y+0), palette_index);
-		triangle_strip.emplace_back(triangle_strip.back());
-		triangle_strip.emplace_back(glm::ivec2(lower_left.x+0, lower_left.y+8), glm::ivec2(tile_coord.x+0, tile_coord.y+8), palette_index);
-		triangle_strip.emplace_back(glm::ivec2(lower_left.x+8, lower_left.y+0), glm::ivec2(tile_coord.x+8, tile_coord.y+0), palette_index);
-		triangle_strip.emplace_back(glm::ivec2(lower_left.x+8, lower_left.y+8), glm::ivec2(tile_coord.x+8, tile_coord.y+8), palette_index);
-		triangle_strip.emplace_back(triangle_strip.back());
-	};
-
-	//helper to draw the sprite list (used because we need to draw the 'behind' sprites, then the background, then the 'front' sprites:
-	auto draw_sprites = [this,&draw_tile](uint8_t priority) {
-		for (auto const &sprite : sprites) {
-			if ((sprite.attributes & 0x80) != priority) continue;
-			draw_tile(
-				glm::ivec2(sprite.x, sprite.y),
-				sprite.index,
-				sprite.attributes & 0x07 //just the palette index part
-			);
-		}
-	};
+	//-------------------------------------------------
+	//Upload at to GPU using PPUDataStream:
 
-	draw_sprites(0x80); //draw sprites with priority == 1 ('behind' sprites)
-
-	{ //draw the background:
-		//To simulate the 'infinite tiling' behavior this code draws the background as four screen-sized chunks,
-		// each of which is drawn at an offset that causes it to overlap the screen.
-
-		static_assert(BackgroundWidth * 8 == ScreenWidth * 2, "Background should be exactly twice the screen width.");
-		static_assert(BackgroundHeight * 8 == ScreenHeight * 2, "Background should be exactly twice the screen height.");
-
-		for (int32_t chunk_y : {0, int32_t(ScreenHeight)}) {
-			for (int32_t chunk_x : {0, int32_t(ScreenWidth)}) {
-				//position of the lower-left corner of the chunk:
-				glm::ivec2 pos = glm::ivec2(chunk_x, chunk_y) + background_position;
-
-				constexpr int32_t BackgroundWidthPixels = int32_t(BackgroundWidth) * 8;
-				constexpr int32_t BackgroundHeightPixels = int32_t(BackgroundHeight) * 8;
-
-				//reduce to (-BackgroundWidthPixels,0] x (-BackgroundHeightPixels,0]:
-				pos.x = ((pos.x % BackgroundWidthPixels) - BackgroundWidthPixels) % BackgroundWidthPixels;
-				pos.y = ((pos.y % BackgroundHeightPixels) - BackgroundHeightPixels) % BackgroundHeightPixels;
-
-				//move chunk if it doesn't overlap the screen:
-				if (pos.x + int32_t(ScreenWidth) <= 0) pos.x += BackgroundWidthPixels;
-				if (pos.y + int32_t(ScreenHeight) <= 0) pos.y += BackgroundHeightPixels;
-
-				int32_t ox = chunk_x / 8;
-				int32_t oy = chunk_y / 8;
-				for (int32_t y = 0; y < int32_t(BackgroundHeight)/2; ++y) {
-					for (int32_t x = 0; x < int32_t(BackgroundWidth)/2; ++x) {
-						uint16_t info = background[(x + ox) + BackgroundWidth * (y + oy)];
-						draw_tile(
-							glm::ivec2(pos.x + 8*x, pos.y + 8*y),
-							info & 0xff, //extract tile index bits
-							(info >> 8) & 0x07 //extract palette index bits
-						);
-					}
+	//region of the stream buffer used this frame:
+	const uint32_t region = data_stream->next_region;
+	data_stream->next_region = (region + 1) % PPUDataStream::StreamRegions;
+	const GLintptr region_offset = GLintptr(region) * PPUDataStream::RegionStride;
+
+	{ //write palettes, background, and sprites to the stream buffer:
+		//make sure the GPU is done with the region:
+		GLsync &fence = data_stream->region_fences[region];
+		if (fence) {
+			if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+				//GPU still using the region -- have to wait:
+				auto before = std::chrono::high_resolution_clock::now();
+				while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {
 				}
-
+				auto after = std::chrono::high_resolution_clock::now();
+				stream_stats_.fence_waits += 1;
+				stream_stats_.fence_wait_seconds += std::chrono::duration< double >(after - before).count();
 			}
+			glDeleteSync(fence);
+			fence = 0;
 		}
+		stream_stats_.frames += 1;
+
+		auto const &palette_table = frame.palette_table;
+		auto const &background = frame.background;
+		auto const &sprites = frame.sprites;
+		static_assert(sizeof(palette_table) == 4 * 4 * std::tuple_size< decltype(FrameData::palette_table) >::value, "palette table is packed");
+		static_assert(sizeof(background) == 2 * BackgroundWidth * BackgroundHeight, "background is packed");
+		static_assert(sizeof(sprites) == 4 * std::tuple_size< decltype(FrameData::sprites) >::value, "sprites are packed");
+
+		//map just this region; 'unsynchronized' because the fence already guarantees the GPU isn't reading it:
+		glBindBuffer(GL_ARRAY_BUFFER, data_stream->stream_buffer);
+		PPUDataStream::Region *mapped = reinterpret_cast< PPUDataStream::Region * >(glMapBufferRange(
+			GL_ARRAY_BUFFER, region_offset, sizeof(PPUDataStream::Region),
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+		));
+		if (mapped) {
+			std::memcpy(static_cast< void * >(&mapped->palette_table), static_cast< void const * >(&palette_table), sizeof(palette_table));
+			std::memcpy(&mapped->background, &background, sizeof(background));
+			std::memcpy(&mapped->sprites, &sprites, sizeof(sprites));
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+		} else {
+			//(this really shouldn't happen, but fall back to a copy if it does)
+			glBufferSubData(GL_ARRAY_BUFFER, region_offset + offsetof(PPUDataStream::Region, palette_table), sizeof(palette_table), palette_table.data());
+			glBufferSubData(GL_ARRAY_BUFFER, region_offset + offsetof(PPUDataStream::Region, background), sizeof(background), background.data());
+			glBufferSubData(GL_ARRAY_BUFFER, region_offset + offsetof(PPUDataStream::Region, sprites), sizeof(sprites), sprites.data());
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 
-	draw_sprites(0x00); //draw sprites with priority == 0 ('in front' sprites)
+	{ //update palette and background textures from the stream buffer:
+		// (with a buffer bound to GL_PIXEL_UNPACK_BUFFER, TexSubImage's 'data' pointer is an offset into that buffer)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, data_stream->stream_buffer);
 
-	assert(triangle_strip.size() == TristripSize && "Triangle strip size was estimated exactly.");
+		glBindTexture(GL_TEXTURE_2D, data_stream->palette_tex);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 4, GLsizei(frame.palette_table.size()), GL_RGBA, GL_UNSIGNED_BYTE,
+			(GLbyte *)0 + region_offset + offsetof(PPUDataStream::Region, palette_table));
 
-	//-------------------------------------------------
-	//Upload at to GPU using PPUDataStream:
+		glBindTexture(GL_TEXTURE_2D, data_stream->background_tex);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, BackgroundWidth, BackgroundHeight, GL_RED_INTEGER, GL_UNSIGNED_SHORT,
+			(GLbyte *)0 + region_offset + offsetof(PPUDataStream::Region, background));
 
-	{ //upload palette texture:
-		static_assert(sizeof(palette_table) == 4 * 4 * decltype(palette_table)().size(), "palette table is packed");
-		glBindTexture(GL_TEXTURE_2D, data_stream->palette_tex);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 4, GLsizei(palette_table.size()), 0, GL_RGBA, GL_UNSIGNED_BYTE, palette_table.data());
 		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 	}
 
-	{ //build + upload tile table texture:
-		//interpret tiles and build a 128 x 128 index texture:
-		static std::array< uint8_t, 128 * 128 > data;
-		for (uint32_t i = 0; i < tile_table.size(); ++i) {
-			Tile const &tile = tile_table[i];
-
-			//location of tile in the texture:
-			uint32_t ox = (i % 16) * 8;
-			uint32_t oy = (i / 16) * 8;
-
-			//copy tile indices into texture:
-			for (uint32_t y = 0; y < 8; ++y) {
-				for (uint32_t x = 0; x < 8; ++x) {
-					data[ox+x + 128 * (oy+y)] =
-						  ((tile.bit0[y] >> x) & 1)
-						| ((tile.bit1[y] >> x) & 1) << 1;
+	{ //upload changed parts of the tile table texture:
+		// (build() has already expanded them into frame.tile_texture)
+		if (frame.tiles_changed.any()) {
+			glBindTexture(GL_TEXTURE_2D, data_stream->tile_tex);
+			if (frame.tiles_changed.all()) {
+				//lots of changes -- cheaper to upload the whole texture at once:
+				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 128, 128, GL_RED_INTEGER, GL_UNSIGNED_BYTE, frame.tile_texture.data());
+			} else {
+				//just a few changes -- upload each changed tile's 8x8 block:
+				glPixelStorei(GL_UNPACK_ROW_LENGTH, 128);
+				for (uint32_t i = 0; i < frame.tiles_changed.size(); ++i) {
+					if (!frame.tiles_changed.test(i)) continue;
+					uint32_t ox = (i % 16) * 8;
+					uint32_t oy = (i / 16) * 8;
+					glTexSubImage2D(GL_TEXTURE_2D, 0, ox, oy, 8, 8, GL_RED_INTEGER, GL_UNSIGNED_BYTE, &frame.tile_texture[ox + 128 * oy]);
 				}
+				glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 			}
+			glBindTexture(GL_TEXTURE_2D, 0);
 		}
-
-		glBindTexture(GL_TEXTURE_2D, data_stream->tile_tex);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, 128, 128, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, data.data());
-		glBindTexture(GL_TEXTURE_2D, 0);
-	}
-
-	{ //upload vertex data:
-		glBindBuffer(GL_ARRAY_BUFFER, data_stream->vertex_buffer);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(decltype(triangle_strip[0])) * triangle_strip.size(), triangle_strip.data(), GL_STREAM_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 
 	//set up the pipeline:
@@ -245,34 +249,59 @@ void PPU466::draw(glm::uvec2 const &drawable_size) const {
 	glBlendEquation(GL_FUNC_ADD);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	// set the shader programs:
-	glUseProgram(tile_program->program);
-
-	// configure attribute streams:
-	glBindVertexArray(data_stream->vertex_buffer_for_tile_program);
+	//NOTE: glm uses column-major matrices:
+	//matrix to transform [0,ScreenWidth]x[0,ScreenHeight] -> [-1,1]x[-1,1]:
+	glm::mat4 OBJECT_TO_CLIP = glm::mat4(
+		glm::vec4(2.0f / ScreenWidth, 0.0f, 0.0f, 0.0f),
+		glm::vec4(0.0f, 2.0f / ScreenHeight, 0.0f, 0.0f),
+		glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
+		glm::vec4(-1.0f,-1.0f, 0.0f, 1.0f)
+	);
 
 	// set uniforms for shader programs:
-	{ //set matrix to transform [0,ScreenWidth]x[0,ScreenHeight] -> [-1,1]x[-1,1]:
-		//NOTE: glm uses column-major matrices:
-		glm::mat4 OBJECT_TO_CLIP = glm::mat4(
-			glm::vec4(2.0f / ScreenWidth, 0.0f, 0.0f, 0.0f),
-			glm::vec4(0.0f, 2.0f / ScreenHeight, 0.0f, 0.0f),
-			glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
-			glm::vec4(-1.0f,-1.0f, 0.0f, 1.0f)
-		);
-		glUniformMatrix4fv(tile_program->OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(OBJECT_TO_CLIP));
-	}
+	glUseProgram(background_program->program);
+	glUniformMatrix4fv(background_program->OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(OBJECT_TO_CLIP));
+	glUniform2i(background_program->BACKGROUND_POSITION_ivec2, frame.background_position.x, frame.background_position.y);
+
+	glUseProgram(tile_program->program);
+	glUniformMatrix4fv(tile_program->OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(OBJECT_TO_CLIP));
 
 	// bind texture units to proper texture objects:
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, data_stream->background_tex);
 	glActiveTexture(GL_TEXTURE1);
 	glBindTexture(GL_TEXTURE_2D, data_stream->palette_tex);
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, data_stream->tile_tex);
 
-	//now that the pipeline is configured, trigger drawing of triangle strip:
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, GLsizei(triangle_strip.size()));
+	//now that the pipeline is configured, trigger drawing:
+
+	// 'behind' sprites:
+	glBindVertexArray(data_stream->sprites_for_tile_program[region]);
+	if (frame.any_behind) {
+		glUniform1ui(tile_program->PRIORITY_uint, 0x80);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(frame.sprites.size()));
+	}
+
+	// background, as one screen-sized quad:
+	glUseProgram(background_program->program);
+	glBindVertexArray(data_stream->empty_vao);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	// 'in front' sprites:
+	glUseProgram(tile_program->program);
+	glBindVertexArray(data_stream->sprites_for_tile_program[region]);
+	if (frame.any_in_front) {
+		glUniform1ui(tile_program->PRIORITY_uint, 0x00);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(frame.sprites.size()));
+	}
+
+	//mark when the GPU will be done reading this frame's region of the stream buffer:
+	data_stream->region_fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 
 	//return state to default:
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, 0);
 	glActiveTexture(GL_TEXTURE1);
 	glBindTexture(GL_TEXTURE_2D, 0);
 	glActiveTexture(GL_TEXTURE0);
@@ -297,15 +326,22 @@ PPUTileProgram::PPUTileProgram() {
 		//vertex shader:
 		"#version 330\n"
 		"uniform mat4 OBJECT_TO_CLIP;\n"
-		"in vec4 Position;\n"
-		"in ivec2 TileCoord;\n"
-		"in int Palette;\n"
+		"uniform uint PRIORITY;\n"
+		"in uvec4 Sprite;\n" //per-instance: (x, y, index, attributes)
 		"out vec2 tileCoord;\n"
 		"flat out int palette;\n"
 		"void main() {\n"
-		"	gl_Position = OBJECT_TO_CLIP * Position;\n"
-		"	tileCoord = TileCoord;\n"
-		"	palette = Palette;\n"
+		//gl_VertexID 0,1,2,3 -> corners (0,0),(s,0),(0,s),(s,s) of the sprite (as a triangle strip):
+		// (s is 8 or, for metasprites, 16 -- the 2x2 block of tiles is contiguous in the tile table texture)
+		"	float size = ((Sprite.w & 0x40u) != 0u ? 16.0 : 8.0);\n"
+		"	vec2 corner = vec2(gl_VertexID & 1, (gl_VertexID >> 1) & 1) * size;\n"
+		"	int index = int(Sprite.z);\n"
+		"	vec2 position = vec2(Sprite.xy) + corner;\n"
+		//sprites of the other priority collapse to a point (so produce no fragments):
+		"	if ((Sprite.w & 0x80u) != PRIORITY) position = vec2(-1.0);\n"
+		"	gl_Position = OBJECT_TO_CLIP * vec4(position, 0.0, 1.0);\n"
+		"	tileCoord = vec2(index % 16, index / 16) * 8.0 + corner;\n"
+		"	palette = int(Sprite.w & 0x7u);\n" //just the palette index part
 		"}\n"
 	,
 		//fragment shader:
@@ -325,12 +361,11 @@ PPUTileProgram::PPUTileProgram() {
 	);
 
 	//look up the locations of vertex attributes:
-	Position_vec2 = glGetAttribLocation(program, "Position");
-	TileCoord_ivec2 = glGetAttribLocation(program, "TileCoord");
-	Palette_int = glGetAttribLocation(program, "Palette");
+	Sprite_uvec4 = glGetAttribLocation(program, "Sprite");
 
 	//look up the locations of uniforms:
 	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
+	PRIORITY_uint = glGetUniformLocation(program, "PRIORITY");
 
 	GLuint TILE_TABLE_usampler2D = glGetUniformLocation(program, "TILE_TABLE");
 	GLuint PALETTE_TABLE_sampler2D = glGetUniformLocation(program, "PALETTE_TABLE");
@@ -353,53 +388,99 @@ PPUTileProgram::~PPUTileProgram() {
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+PPUBackgroundProgram::PPUBackgroundProgram() {
+	program = gl_compile_program(
+		//vertex shader:
+		"#version 330\n"
+		"uniform mat4 OBJECT_TO_CLIP;\n"
+		"out vec2 screenCoord;\n"
+		"void main() {\n"
+		//gl_VertexID 0,1,2,3 -> corners (0,0),(1,0),(0,1),(1,1) of the screen (as a triangle strip):
+		"	vec2 corner = vec2(gl_VertexID & 1, (gl_VertexID >> 1) & 1);\n"
+		"	screenCoord = corner * vec2(" + std::to_string(PPU466::ScreenWidth) + ", " + std::to_string(PPU466::ScreenHeight) + ");\n"
+		"	gl_Position = OBJECT_TO_CLIP * vec4(screenCoord, 0.0, 1.0);\n"
+		"}\n"
+	,
+		//fragment shader:
+		"#version 330\n"
+		"uniform usampler2D TILE_TABLE;\n"
+		"uniform sampler2D PALETTE_TABLE;\n"
+		"uniform usampler2D BACKGROUND;\n"
+		"uniform ivec2 BACKGROUND_POSITION;\n" //already wrapped into [0,size) on the CPU
+		"in vec2 screenCoord;\n"
+		"out vec4 fragColor;\n"
+		"void main() {\n"
+		"	ivec2 size = textureSize(BACKGROUND, 0) * 8;\n" //background size in pixels
+		//screen pixel -> pixel within the (infinitely repeating) background:
+		"	ivec2 px = (ivec2(floor(screenCoord)) - BACKGROUND_POSITION + size) % size;\n"
+		"	uint info = texelFetch(BACKGROUND, px / 8, 0).r;\n"
+		"	int tile = int(info & 0xffu);\n" //extract tile index bits
+		"	int palette = int((info >> 8) & 0x7u);\n" //extract palette index bits
+		"	ivec2 tileCoord = ivec2(tile % 16, tile / 16) * 8 + px % 8;\n"
+		"	uint index = texelFetch(TILE_TABLE, tileCoord, 0).r;\n"
+		"	fragColor = texelFetch(PALETTE_TABLE, ivec2(index, palette), 0);\n"
+		"}\n"
+	);
+
+	//look up the locations of uniforms:
+	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
+	BACKGROUND_POSITION_ivec2 = glGetUniformLocation(program, "BACKGROUND_POSITION");
+
+	GLuint TILE_TABLE_usampler2D = glGetUniformLocation(program, "TILE_TABLE");
+	GLuint PALETTE_TABLE_sampler2D = glGetUniformLocation(program, "PALETTE_TABLE");
+	GLuint BACKGROUND_usampler2D = glGetUniformLocation(program, "BACKGROUND");
+
+	//bind texture units indices to samplers:
+	glUseProgram(program);
+	glUniform1i(TILE_TABLE_usampler2D, 0);
+	glUniform1i(PALETTE_TABLE_sampler2D, 1);
+	glUniform1i(BACKGROUND_usampler2D, 2);
+	glUseProgram(0);
+
+	GL_ERRORS();
+}
+
+PPUBackgroundProgram::~PPUBackgroundProgram() {
+	if (program != 0) {
+		glDeleteProgram(program);
+		program = 0;
+	}
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
 
 //PPU data is streamed to the GPU (read: uploaded 'just in time') using a few buffers:
 PPUDataStream::PPUDataStream() {
 
-	//vertex_buffer_for_tile_program is a vertex array object that tells the GPU the layout of data in vertex_buffer:
-	glGenVertexArrays(1, &vertex_buffer_for_tile_program);
-	glBindVertexArray(vertex_buffer_for_tile_program);
-
-	//vertex_buffer will (eventually) hold vertex data for drawing:
-	glGenBuffers(1, &vertex_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-
-	//Notice how this binding is attaching an integer input to a floating point attribute:
-	glVertexAttribPointer(
-		tile_program->Position_vec2, //attribute
-		2, //size
-		GL_INT, //type
-		GL_FALSE, //normalized
-		sizeof(Vertex), //stride
-		(GLbyte *)0 + offsetof(Vertex, Position) //offset
-	);
-	glEnableVertexAttribArray(tile_program->Position_vec2);
-
-	//the "I" variant binds to an integer attribute:
-	glVertexAttribIPointer(
-		tile_program->TileCoord_ivec2, //attribute
-		2, //size
-		GL_INT, //type
-		sizeof(Vertex), //stride
-		(GLbyte *)0 + offsetof(Vertex, TileCoord) //offset
-	);
-	glEnableVertexAttribArray(tile_program->TileCoord_ivec2);
-
-	//I could have stored the Palette as another entry in the TileCoord attribute stream
-	glVertexAttribIPointer(
-		tile_program->Palette_int, //attribute
-		1, //size
-		GL_UNSIGNED_INT, //type
-		sizeof(Vertex), //stride
-		(GLbyte *)0 + offsetof(Vertex, Palette) //offset
-	);
-	glEnableVertexAttribArray(tile_program->Palette_int);
+	//stream_buffer will (eventually) hold per-frame data; allocate space for the whole ring:
+	glGenBuffers(1, &stream_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, stream_buffer);
+	glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(StreamRegions) * RegionStride, nullptr, GL_STREAM_DRAW);
+
+	region_fences.fill(0);
+
+	//sprites_for_tile_program are vertex array objects that tell the GPU the layout of the sprites in each region:
+	glGenVertexArrays(GLsizei(sprites_for_tile_program.size()), sprites_for_tile_program.data());
+	for (uint32_t r = 0; r < StreamRegions; ++r) {
+		glBindVertexArray(sprites_for_tile_program[r]);
+
+		//the "I" variant binds to an integer attribute -- here, the four bytes of each sprite become a uvec4:
+		glVertexAttribIPointer(
+			tile_program->Sprite_uvec4, //attribute
+			4, //size
+			GL_UNSIGNED_BYTE, //type
+			sizeof(PPU466::Sprite), //stride
+			(GLbyte *)0 + r * RegionStride + offsetof(Region, sprites) //offset
+		);
+		glEnableVertexAttribArray(tile_program->Sprite_uvec4);
+		//advance once per instance (i.e., per sprite) rather than once per vertex:
+		glVertexAttribDivisor(tile_program->Sprite_uvec4, 1);
+	}
+	glBindVertexArray(0);
 
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	glBindVertexArray(0);
-
 
 	glGenTextures(1, &tile_tex);
 	glBindTexture(GL_TEXTURE_2D, tile_tex);
@@ -429,17 +510,41 @@ PPUDataStream::PPUDataStream() {
 	glBindTexture(GL_TEXTURE_2D, 0);
 
 
+	glGenTextures(1, &background_tex);
+	glBindTexture(GL_TEXTURE_2D, background_tex);
+	//passing 'nullptr' to TexImage says "allocate memory but don't store anything there":
+	// (textures will be uploaded later)
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R16UI, PPU466::BackgroundWidth, PPU466::BackgroundHeight, 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT, nullptr);
+	//integer textures can only be sampled with nearest filtering:
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	//(wrapping is done in the shader, so clamp is fine here)
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+
+	//core profile requires a vertex array object to be bound even when drawing without attributes:
+	glGenVertexArrays(1, &empty_vao);
+
+
 	GL_ERRORS();
 }
 
 PPUDataStream::~PPUDataStream() {
-	if (vertex_buffer_for_tile_program != 0) {
-		glDeleteVertexArrays(1, &vertex_buffer_for_tile_program);
-		vertex_buffer_for_tile_program = 0;
+	for (auto &fence : region_fences) {
+		if (fence != 0) {
+			glDeleteSync(fence);
+			fence = 0;
+		}
 	}
-	if (vertex_buffer != 0) {
-		glDeleteBuffers(1, &vertex_buffer);
-		vertex_buffer = 0;
+	if (sprites_for_tile_program[0] != 0) {
+		glDeleteVertexArrays(GLsizei(sprites_for_tile_program.size()), sprites_for_tile_program.data());
+		sprites_for_tile_program.fill(0);
+	}
+	if (stream_buffer != 0) {
+		glDeleteBuffers(1, &stream_buffer);
+		stream_buffer = 0;
 	}
 	if (tile_tex != 0) {
 		glDeleteTextures(1, &tile_tex);
@@ -449,4 +554,12 @@ PPUDataStream::~PPUDataStream() {
 		glDeleteTextures(1, &palette_tex);
 		palette_tex = 0;
 	}
+	if (background_tex != 0) {
+		glDeleteTextures(1, &background_tex);
+		background_tex = 0;
+	}
+	if (empty_vao != 0) {
+		glDeleteVertexArrays(1, &empty_vao);
+		empty_vao = 0;
+	}
 }
@@ -7,6 +7,8 @@
 
 #include <glm/glm.hpp>
 #include <array>
+#include <bitset>
+#include <vector>
 
 struct PPU466 {
 	PPU466();
@@ -18,6 +20,32 @@ struct PPU466 {
 	// pass the size of the current framebuffer in pixels so it knows how to scale itself
 	void draw(glm::uvec2 const &drawable_size) const;
 
+	//draw() is done in two stages, which can also be called separately:
+	// build() does all of the CPU-side work (no OpenGL calls), producing a FrameData;
+	// submit() uploads a FrameData and draws it (only OpenGL calls).
+	//So, e.g., the next frame can be built on another thread while the previous one is submitted.
+	//
+	//NOTE: build() consumes the tile table change marks (see mark_tile_dirty) and a FrameData only
+	// carries the tile changes since the previous build(), so every built FrameData must be submitted,
+	// in the order they were built. (build() itself should only be called from one thread at a time.)
+	struct FrameData;
+	void build(FrameData &frame) const;
+	static void submit(FrameData const &frame, glm::uvec2 const &drawable_size);
+
+	//to draw without a GPU (e.g., for headless golden-image checks), the PPU can also draw on the CPU:
+	// fills 'out' with the ScreenWidth x ScreenHeight image draw() would produce
+	// rows are stored bottom-to-top (i.e., LowerLeftOrigin for save_png) and alpha is always 0xff
+	void render_to_buffer(std::vector< glm::u8vec4 > *out) const;
+
+	//draw() streams per-frame data through a small ring of buffer regions, and only waits
+	// on the GPU if it runs a full ring ahead; these counters (shared by all PPU466s) track that:
+	struct StreamStats {
+		uint64_t frames = 0; //frames streamed
+		uint64_t fence_waits = 0; //frames that had to wait for the GPU to finish with a region
+		double fence_wait_seconds = 0.0; //total time spent waiting
+	};
+	static StreamStats const &stream_stats();
+
 	//--------------------------------------------------------------
 	//Set the values below to control the PPU's drawing:
 
@@ -67,6 +95,16 @@ struct PPU466 {
 	//  this is often thought of as a 16x16 grid of tiles.
 	std::array< Tile, 16 * 16 > tile_table;
 
+	//Tile Table Changes:
+	// Expanding and uploading the tile table is relatively expensive, so draw() (really, build()) only
+	//  re-uploads tiles that have been marked as changed since the last draw().
+	// All tiles start out marked, so filling in tile_table before the first draw() just works;
+	//  if you modify tile_table after that, mark the tiles you touched:
+	void mark_tile_dirty(uint8_t index) { tile_dirty.set(index); }
+	void mark_all_tiles_dirty() { tile_dirty.set(); }
+	//(bits are cleared by draw() / build(), hence 'mutable')
+	mutable std::bitset< 16 * 16 > tile_dirty;
+
 	//Background Layer:
 	// The PPU's background layer is made of 64x60 tiles (512 x 480 pixels).
 	// This is twice the size of the screen, to support scrolling.
@@ -109,16 +147,24 @@ struct PPU466 {
 	//
 	//  the sprite 'attributes' byte gives:
 	//   bits:  7 6 5 4 3 2 1 0
-	//         |-|-------|-----|
-	//          ^    ^      ^
-	//          |    |      '---- palette index (bits 0-2)
-	//          |    '----------- unused (set to zero)
-	//          '---------------- priority bit (bit 7)
+	//         |-|-|---|-----|
+	//          ^ ^  ^    ^
+	//          | |  |    '---- palette index (bits 0-2)
+	//          | |  '--------- unused (set to zero)
+	//          | '------------ size bit (bit 6)
+	//          '-------------- priority bit (bit 7)
 	//
 	//  the 'priority bit' chooses whether to render the sprite
 	//   in front of (priority = 0) the background
 	//   or behind (priority = 1) the background
 	//
+	//  the 'size bit' chooses whether the sprite is
+	//   a single 8x8 tile (size = 0)
+	//   or a 16x16 'metasprite' (size = 1) made of the 2x2 block of tiles:
+	//      [index+16][index+17]
+	//      [index+ 0][index+ 1]
+	//   (so a metasprite's index should not be in the last row or column of the 16x16 tile table)
+	//
 	struct Sprite {
 		uint8_t x = 0; //x position. 0 is the left edge of the screen.
 		uint8_t y = 240; //y position. 0 is the bottom edge of the screen. >= 240 is off-screen
@@ -136,4 +182,26 @@ struct PPU466 {
 	//  any sprites you don't want to use should be moved off the screen (y >= 240)
 	std::array< Sprite, 64 > sprites;
 
+	//--------------------------------------------------------------
+	//Everything submit() needs to draw a frame:
+	// (about 24k, so keep one around instead of making a new one every frame)
+	struct FrameData {
+		glm::u8vec3 background_color = glm::u8vec3(0x00, 0x00, 0x00);
+		//background_position, wrapped to [0,BackgroundWidth*8) x [0,BackgroundHeight*8):
+		glm::ivec2 background_position = glm::ivec2(0,0);
+
+		//are there any sprites of each priority?
+		bool any_behind = false;
+		bool any_in_front = false;
+
+		decltype(PPU466::palette_table) palette_table;
+		decltype(PPU466::background) background;
+		decltype(PPU466::sprites) sprites;
+
+		//The tile table, expanded to 128x128 color indices (tile i at (i % 16, i / 16) * 8):
+		// only the tiles marked in tiles_changed are guaranteed to be up to date,
+		// unless every tile is marked (then all of them are).
+		std::array< uint8_t, 128 * 128 > tile_texture;
+		std::bitset< 16 * 16 > tiles_changed;
+	};
 };
@@ -0,0 +1,265 @@
+#include "PPU466.hpp"
+
+//This file holds the parts of the PPU466 that run entirely on the CPU.
+// (it doesn't touch OpenGL, so it can be used without a window or context)
+
+#include "bitplanes.hpp"
+
+#include <cstring>
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PPU466_CPU_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+	//submit() shares one tile table texture between all PPU466s, so remember whose tiles were built last:
+	// (if a different PPU466 builds, its whole tile table needs to go into the texture)
+	PPU466 const *tiles_built_by = nullptr;
+
+	//Colors are handled as packed 32-bit values with the same byte layout as glm::u8vec4:
+	uint32_t pack(glm::u8vec4 const &c) {
+		uint32_t ret;
+		std::memcpy(&ret, static_cast< void const * >(&c), 4);
+		return ret;
+	}
+
+	//A palette, prepared for drawing:
+	struct LinePalette {
+		uint32_t color[4];
+		uint32_t opaque[4]; //0xffffffff if color has alpha == 0xff, 0 otherwise
+		//'simple' palettes only have fully transparent or fully opaque colors, so drawing never needs to blend:
+		bool simple;
+	};
+
+	LinePalette prepare(PPU466::Palette const &palette) {
+		LinePalette ret;
+		ret.simple = true;
+		for (uint32_t i = 0; i < 4; ++i) {
+			ret.color[i] = pack(palette[i]);
+			ret.opaque[i] = (palette[i].a == 0xff ? 0xffffffff : 0);
+			if (palette[i].a != 0x00 && palette[i].a != 0xff) ret.simple = false;
+		}
+		return ret;
+	}
+
+	//Blend src over dst with the same (SRC_ALPHA, ONE_MINUS_SRC_ALPHA) function draw() uses:
+	// (dst alpha is ignored, since the final image is always opaque)
+	uint32_t blend(uint32_t src, uint32_t dst) {
+		uint8_t s[4], d[4];
+		std::memcpy(s, &src, 4);
+		std::memcpy(d, &dst, 4);
+		uint32_t a = s[3];
+		for (uint32_t c = 0; c < 3; ++c) {
+			//round-to-nearest of (s * a + d * (255 - a)) / 255, as 8-bit unorm framebuffers do:
+			d[c] = uint8_t((s[c] * a + d[c] * (255 - a) + 127) / 255);
+		}
+		uint32_t ret;
+		std::memcpy(&ret, d, 4);
+		return ret;
+	}
+
+	//Draw one row of a tile (given as its two bit-plane bytes) over the eight pixels starting at dst:
+	void draw_row(uint32_t *dst, uint8_t bit0, uint8_t bit1, LinePalette const &pal) {
+		if (!pal.simple) {
+			//slow path -- some colors are partially transparent:
+			for (uint32_t x = 0; x < 8; ++x) {
+				uint32_t index = ((bit0 >> x) & 1) | (((bit1 >> x) & 1) << 1);
+				uint8_t c[4];
+				std::memcpy(c, &pal.color[index], 4);
+				if (c[3] == 0xff) dst[x] = pal.color[index];
+				else if (c[3] != 0x00) dst[x] = blend(pal.color[index], dst[x]);
+			}
+			return;
+		}
+
+		if ((bit0 | bit1) == 0 && !pal.opaque[0]) return; //all color 0, which is invisible
+
+#ifdef PPU466_CPU_SSE2
+		//bit-plane decode + palette lookup for four pixels at a time:
+		// each 32-bit lane tests one bit of the bit-plane bytes, then selects a palette color with masks.
+		const __m128i b0 = _mm_set1_epi32(bit0);
+		const __m128i b1 = _mm_set1_epi32(bit1);
+		const __m128i c0 = _mm_set1_epi32(int32_t(pal.color[0]));
+		const __m128i c1 = _mm_set1_epi32(int32_t(pal.color[1]));
+		const __m128i c2 = _mm_set1_epi32(int32_t(pal.color[2]));
+		const __m128i c3 = _mm_set1_epi32(int32_t(pal.color[3]));
+		const __m128i o0 = _mm_set1_epi32(int32_t(pal.opaque[0]));
+		const __m128i o1 = _mm_set1_epi32(int32_t(pal.opaque[1]));
+		const __m128i o2 = _mm_set1_epi32(int32_t(pal.opaque[2]));
+		const __m128i o3 = _mm_set1_epi32(int32_t(pal.opaque[3]));
+		for (uint32_t half = 0; half < 2; ++half) {
+			const __m128i sel = (half == 0 ? _mm_setr_epi32(0x01, 0x02, 0x04, 0x08) : _mm_setr_epi32(0x10, 0x20, 0x40, 0x80));
+			const __m128i m0 = _mm_cmpeq_epi32(_mm_and_si128(b0, sel), sel); //bit 0 of color index set
+			const __m128i m1 = _mm_cmpeq_epi32(_mm_and_si128(b1, sel), sel); //bit 1 of color index set
+
+			//select between colors (and opaque flags) based on the index bits:
+			const __m128i c01 = _mm_or_si128(_mm_andnot_si128(m0, c0), _mm_and_si128(m0, c1));
+			const __m128i c23 = _mm_or_si128(_mm_andnot_si128(m0, c2), _mm_and_si128(m0, c3));
+			const __m128i color = _mm_or_si128(_mm_andnot_si128(m1, c01), _mm_and_si128(m1, c23));
+			const __m128i o01 = _mm_or_si128(_mm_andnot_si128(m0, o0), _mm_and_si128(m0, o1));
+			const __m128i o23 = _mm_or_si128(_mm_andnot_si128(m0, o2), _mm_and_si128(m0, o3));
+			const __m128i opaque = _mm_or_si128(_mm_andnot_si128(m1, o01), _mm_and_si128(m1, o23));
+
+			__m128i *out = reinterpret_cast< __m128i * >(dst + 4 * half);
+			const __m128i old = _mm_loadu_si128(out);
+			_mm_storeu_si128(out, _mm_or_si128(_mm_and_si128(opaque, color), _mm_andnot_si128(opaque, old)));
+		}
+#else
+		for (uint32_t x = 0; x < 8; ++x) {
+			uint32_t index = ((bit0 >> x) & 1) | (((bit1 >> x) & 1) << 1);
+			if (pal.opaque[index]) dst[x] = pal.color[index];
+		}
+#endif
+	}
+}
+
+PPU466::PPU466() {
+	tile_dirty.set(); //tile table hasn't been uploaded yet
+	for (auto &palette : palette_table) {
+		palette[0] = glm::u8vec4(0x00, 0x00, 0x00, 0x00);
+		palette[1] = glm::u8vec4(0x44, 0x44, 0x44, 0xff);
+		palette[2] = glm::u8vec4(0x99, 0x99, 0x99, 0xff);
+		palette[3] = glm::u8vec4(0xff, 0xff, 0xff, 0xff);
+	}
+
+	for (auto &tile : tile_table) {
+		tile.bit0 = { 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0 };
+		tile.bit1 = { 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff };
+	}
+
+	for (uint32_t i = 0; i < background.size(); ++i) {
+		background[i] = int16_t(
+			  (i % 8) << 8 //cycle through all palettes
+			| (i % palette_table.size()) //cycle through all tiles
+		);
+	}
+}
+
+void PPU466::build(FrameData &frame) const {
+	frame.background_color = background_color;
+
+	//To simulate the 'infinite tiling' behavior, the background shader wraps screen pixels into the background;
+	// it expects a background position already reduced to [0,BackgroundWidthPixels) x [0,BackgroundHeightPixels):
+	constexpr int32_t BackgroundWidthPixels = int32_t(BackgroundWidth) * 8;
+	constexpr int32_t BackgroundHeightPixels = int32_t(BackgroundHeight) * 8;
+	frame.background_position = glm::ivec2(
+		((background_position.x % BackgroundWidthPixels) + BackgroundWidthPixels) % BackgroundWidthPixels,
+		((background_position.y % BackgroundHeightPixels) + BackgroundHeightPixels) % BackgroundHeightPixels
+	);
+
+	//sprites are drawn in two instanced passes (behind and in front of the background), either of which may be skipped:
+	frame.any_behind = false;
+	frame.any_in_front = false;
+	for (auto const &sprite : sprites) {
+		if (sprite.attributes & 0x80) frame.any_behind = true;
+		else frame.any_in_front = true;
+	}
+
+	frame.palette_table = palette_table;
+	frame.background = background;
+	frame.sprites = sprites;
+
+	//expand changed tiles into the tile table texture:
+	if (tiles_built_by != this) {
+		tile_dirty.set();
+		tiles_built_by = this;
+	}
+	frame.tiles_changed = tile_dirty;
+	tile_dirty.reset();
+	if (frame.tiles_changed.count() > tile_table.size() / 4) {
+		//lots of changes -- submit() will upload the whole texture, so make sure all of it is current:
+		// (a FrameData may have missed changes built into a different FrameData)
+		frame.tiles_changed.set();
+	}
+	if (frame.tiles_changed.none()) return;
+	for (uint32_t i = 0; i < tile_table.size(); ++i) {
+		if (!frame.tiles_changed.test(i)) continue;
+		//location of tile in the texture:
+		uint32_t ox = (i % 16) * 8;
+		uint32_t oy = (i / 16) * 8;
+		bitplanes_expand_tile(tile_table[i], &frame.tile_texture[ox + 128 * oy], 128);
+	}
+}
+
+void PPU466::render_to_buffer(std::vector< glm::u8vec4 > *out_) const {
+	assert(out_);
+	auto &out = *out_;
+	out.resize(ScreenWidth * ScreenHeight);
+
+	//prepare palettes once per frame:
+	std::array< LinePalette, 8 > palettes;
+	static_assert(palettes.size() == decltype(palette_table)().size(), "one prepared palette per palette table entry");
+	for (uint32_t i = 0; i < palette_table.size(); ++i) {
+		palettes[i] = prepare(palette_table[i]);
+	}
+
+	//The image is built one scanline at a time in a padded line buffer:
+	// (padding means partly-offscreen tiles and metasprites don't need clipping)
+	constexpr int32_t PadLeft = 8;
+	constexpr int32_t PadRight = 16;
+	std::array< uint32_t, PadLeft + ScreenWidth + PadRight > line;
+	uint32_t *screen = line.data() + PadLeft;
+
+	const uint32_t clear = pack(glm::u8vec4(background_color, 0xff));
+	const uint32_t alpha_mask = pack(glm::u8vec4(0x00, 0x00, 0x00, 0xff));
+
+	//same wrapping as draw(): background_position reduced to [0,BackgroundWidthPixels) x [0,BackgroundHeightPixels):
+	constexpr int32_t BackgroundWidthPixels = int32_t(BackgroundWidth) * 8;
+	constexpr int32_t BackgroundHeightPixels = int32_t(BackgroundHeight) * 8;
+	const glm::ivec2 wrapped_background_position = glm::ivec2(
+		((background_position.x % BackgroundWidthPixels) + BackgroundWidthPixels) % BackgroundWidthPixels,
+		((background_position.y % BackgroundHeightPixels) + BackgroundHeightPixels) % BackgroundHeightPixels
+	);
+
+	//helper to draw the part of the sprite list with a given priority that overlaps scanline y:
+	auto draw_sprites = [this,&palettes,screen](int32_t y, uint8_t priority) {
+		for (auto const &sprite : sprites) {
+			if ((sprite.attributes & 0x80) != priority) continue;
+			int32_t row = y - int32_t(sprite.y);
+			LinePalette const &palette = palettes[sprite.attributes & 0x07];
+			if (sprite.attributes & 0x40) {
+				//16x16 metasprite -- two tiles wide, from the bottom or top row of its 2x2 block:
+				if (row < 0 || row >= 16) continue;
+				uint8_t index = uint8_t(sprite.index + (row / 8) * 16);
+				Tile const &left = tile_table[index];
+				Tile const &right = tile_table[uint8_t(index + 1)];
+				draw_row(screen + sprite.x, left.bit0[row % 8], left.bit1[row % 8], palette);
+				draw_row(screen + sprite.x + 8, right.bit0[row % 8], right.bit1[row % 8], palette);
+			} else {
+				if (row < 0 || row >= 8) continue;
+				Tile const &tile = tile_table[sprite.index];
+				draw_row(screen + sprite.x, tile.bit0[row], tile.bit1[row], palette);
+			}
+		}
+	};
+
+	for (int32_t y = 0; y < int32_t(ScreenHeight); ++y) {
+		line.fill(clear);
+
+		draw_sprites(y, 0x80); //sprites with priority == 1 ('behind' sprites)
+
+		{ //background:
+			//background pixel shown at the left edge of this scanline:
+			int32_t bx = (BackgroundWidthPixels - wrapped_background_position.x) % BackgroundWidthPixels;
+			int32_t by = (y - wrapped_background_position.y + BackgroundHeightPixels) % BackgroundHeightPixels;
+			uint16_t const *row_info = &background[BackgroundWidth * (by / 8)];
+			uint32_t tile_x = bx / 8;
+			for (int32_t x = -(bx % 8); x < int32_t(ScreenWidth); x += 8) {
+				uint16_t info = row_info[tile_x];
+				Tile const &tile = tile_table[info & 0xff]; //extract tile index bits
+				draw_row(screen + x, tile.bit0[by % 8], tile.bit1[by % 8], palettes[(info >> 8) & 0x07]); //extract palette index bits
+				tile_x = (tile_x + 1) % BackgroundWidth;
+			}
+		}
+
+		draw_sprites(y, 0x00); //sprites with priority == 0 ('in front' sprites)
+
+		//copy the visible part of the line to the output, setting alpha to 0xff along the way:
+		for (uint32_t x = 0; x < ScreenWidth; ++x) {
+			screen[x] |= alpha_mask;
+		}
+		std::memcpy(static_cast< void * >(&out[ScreenWidth * y]), screen, ScreenWidth * 4);
+	}
+}
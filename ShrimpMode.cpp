@@ -8,93 +8,29 @@
 #include <glm/ext.hpp>
 #include <glm/gtx/string_cast.hpp>
 
-//for loading/saving PNGs, reading/writing chunk info
-#include "load_save_png.hpp"
+//for the sprites (converted from PNGs ahead of time by pack-sprites):
+#include "SpriteBundle.hpp"
+#include "TileAllocator.hpp"
+#include "Load.hpp"
+#include "data_path.hpp"
 
+#include <iostream>
 #include <random>
 #include <assert.h>
 
+// Release builds can define EMBED_SPRITES to compile the sprites into the game (see Jamfile),
+// so there's no file to read at all; either way, the sprites come out as the same SpriteBundle
+#ifdef EMBED_SPRITES
+#include "embedded_sprites.hpp"
+#endif
 
-PPU466::Palette get_palette(glm::uvec2 size, std::vector< glm::u8vec4 > data) {    
-    // Build dummy palette to grab four colors
-    PPU466::Palette palette = {glm::u8vec4(0), glm::u8vec4(0), glm::u8vec4(0), glm::u8vec4(0)};
-    
-    glm::u8vec4 temp_color;
-    int32_t seen_color_inds = 1;  // assume the first color is transparent, so we read only up to 3 colors
-    int32_t i = 0;
-    while ((seen_color_inds < 4) && (i < size.x * size.y)) {
-        temp_color = data[i];
-
-        // Check colors seen so far, setting colors if they're new
-        if (temp_color == palette[0] || temp_color == palette[1] 
-         || temp_color == palette[2] || temp_color == palette[3]) {
-            i++;
-            continue;
-        }
-        if (temp_color != palette[seen_color_inds]) {
-            palette[seen_color_inds] = temp_color;
-            seen_color_inds++;
-        }
-        i++;
-    }
-
-    return palette;
-}
-
-
-PPU466::Tile set_tilebits(int32_t tile_row, int32_t tile_col,
-                     PPU466::Palette palette, 
-                     glm::uvec2 size, std::vector< glm::u8vec4 > &data) {
-    // Zero-fill tile
-    PPU466::Tile tile;
-    tile.bit0.fill(0);
-    tile.bit1.fill(0);
-
-    // Fill pixel in the canonical row-major order (lower-left -> bottom-right) 
-    glm::u8vec4 pix_color;
-    for (int32_t pix_y = 0; pix_y < 8; pix_y++) {
-        for (int32_t pix_x = 0; pix_x < 8; pix_x++) {
-            pix_color = data[((tile_row + pix_y) * size.x) + (tile_col + pix_x)];
-            // Set color bit according to palette
-            for (int8_t pal_ind = 0; pal_ind < 4; pal_ind++) {
-                if (pix_color == palette[pal_ind]) {
-                    // If palette color at IND matches, set corresponding high/low bits
-                    // in the tile, at the column index pix_x
-                    tile.bit0[pix_y] |=  ((pal_ind & 0x1) << pix_x);
-                    tile.bit1[pix_y] |= (((pal_ind & 0x2) << pix_x) >> 1); // need to shift higher bit back down before setting
-                }
-            }
-        }
-    }    
-    return tile;
-}
-
-
-void ShrimpMode::set_sprite_tiles(glm::uvec2 sprite_size, 
-                      std::vector< glm::u8vec4 > &sprite_data,
-                      PPU466::Palette &sprite_palette,
-                      uint8_t &tile_ind) {
-    //Sprites should be of size 16x16 pixels => 2x2 tiles
-    assert(((sprite_size.x / 8) == sprite_tile_dim) && ((sprite_size.y / 8) == sprite_tile_dim));
-
-    // Set tile bits for the 2x2 tiles of the sprite:
-    // Break up 16x16 image into 4 8x8 tiles
-    for (int32_t tile_y = 0; tile_y < sprite_tile_dim; tile_y++) {
-        for (int32_t tile_x = 0; tile_x < sprite_tile_dim; tile_x++) {
-            // Tiles start offset 8
-            int32_t tile_row_start = tile_y * 8;    
-            int32_t tile_col_start = tile_x * 8;
-
-            // Set color bits for tile directly
-            PPU466::Tile result = 
-                    set_tilebits(tile_row_start, tile_col_start, sprite_palette, sprite_size, sprite_data);
-
-            ppu.tile_table[tile_ind].bit0 = result.bit0;
-            ppu.tile_table[tile_ind].bit1 = result.bit1;
-            tile_ind++;
-        }
-    }
-}
+Load< SpriteBundle > shrimp_sprites(LoadTagDefault, []() -> SpriteBundle const * {
+#ifdef EMBED_SPRITES
+    return new SpriteBundle(embedded_sprites);
+#else
+    return new SpriteBundle(data_path("shrimp.sprites"));
+#endif
+}, LoadOnAnyThread); //doesn't need the GL context
 
 
 ShrimpMode::ShrimpMode() {
@@ -139,62 +75,48 @@ ShrimpMode::ShrimpMode() {
         ppu.background[bg_ind] = 255; 
     }
 
-    // -------------------------- Load PNGs -------------------------- 
+    // Move all sprites off the screen until they're used
+    for (auto &sprite : ppu.sprites) {
+        sprite.y = 240;
+    }
+
+    // -------------------------- Load Sprites -------------------------- 
     // As we make sprites, helps to track which tiles/palettes are occupied
     uint8_t palette_ind = 1;
-    uint8_t tile_ind = 0;
     uint8_t sprite_ind = 0;
 
-    // The following asset pipeline routine and its subroutines to convert a PNG into a sprite
-    // (steps include creating a color palette and setting tiles) is loosely 
+    // Each sprite's 2x2 tiles go in a block of the tile table; sprites with identical art share a block
+    // (the last block is left alone, since the background uses tile 255)
+    tile_allocator.reset(new TileAllocator(ppu, 63));
+
+    // The asset pipeline routine that converts a PNG into a sprite (creating a color palette and
+    // setting tiles) now runs ahead of time in pack-sprites (see SpriteBundle.cpp); it is loosely 
     // inspired by https://github.com/riyuki15/15-466-f20-base1/blob/master/PlayMode.cpp
-    auto configure_sprite = [this](const char* filename, 
+    auto configure_sprite = [this](std::string const &name, 
                                     SpriteType type, bool consumed,
-                                    uint8_t palette_ind, uint8_t &tile_ind, uint8_t &sprite_ind,
+                                    uint8_t palette_ind, uint8_t &sprite_ind,
                                     uint8_t x, uint8_t y) {
-        // Load sprite
-        glm::uvec2 size;
-        std::vector< glm::u8vec4 > data;
-        load_png(filename, &size, &data, LowerLeftOrigin);
-
-        // Create metadata tracking sprite
-        sprite_infos.emplace_back(SpriteInfo());
-        sprite_infos.back().type = type;
-        sprite_infos.back().consumed = consumed;
-        sprite_infos.back().palette_index = palette_ind;
-        sprite_infos.back().start_tile_index = tile_ind;
-        sprite_infos.back().sprite_index = sprite_ind;
-
-        // Get sprite palette
-        ppu.palette_table[palette_ind] = get_palette(size, data);
-
-        // Set sprite tiles
-        set_sprite_tiles(size, data, ppu.palette_table[palette_ind], tile_ind);
-
-        // Initialize sprite attributes
-        // Most sprites will stay static in one location
-        ppu.sprites[sprite_ind].x = x;
-        ppu.sprites[sprite_ind].y = y;
-        ppu.sprites[sprite_ind].index = sprite_infos.back().start_tile_index;
-        ppu.sprites[sprite_ind].attributes = palette_ind;
-
-        // 4 smaller sprites make up our sprite
-        sprite_ind += sprites_per_sprite;
-    };
+        // Look up sprite
+        SpriteBundle::Sprite const &sprite = shrimp_sprites->lookup(name);
 
-    // Sets x,y,tile,palette information for a newly added sprite's subtiles given the starting x,y of the sprite
-    auto fix_sprite_tiles = [this](uint8_t start_x, uint8_t start_y) {
-        for (int32_t r = 0; r < sprite_tile_dim; r++) {
-            for (int32_t c = 0; c < sprite_tile_dim; c++) {
-                uint32_t sprite_i = sprite_infos.back().sprite_index + (r * sprite_tile_dim) + c;
-                uint8_t row_offset = r * 8; // offset for y
-                uint8_t col_offset = c * 8; // offset for x
-                ppu.sprites[sprite_i].x = start_x + col_offset;
-                ppu.sprites[sprite_i].y = start_y + row_offset;
-                ppu.sprites[sprite_i].index = sprite_infos.back().start_tile_index + (r * sprite_tile_dim) + c;
-                ppu.sprites[sprite_i].attributes = sprite_infos.back().palette_index;
-            }
-        }
+        // Create the entity tracking the sprite
+        // Most sprites will stay static in one location
+        uint8_t tile_index = tile_allocator->allocate_block(sprite.tiles);
+        uint32_t entity = entities.add(x, y, uint8_t(type), palette_ind, tile_index, sprite_ind);
+        entities.set_consumed(entity, consumed);
+
+        // Set sprite palette
+        ppu.palette_table[palette_ind] = sprite.palette;
+
+        // Remember where the art went, for reloading
+        ArtSlot &art = art_slots[name];
+        art.tile_index = tile_index;
+        art.palette_index = palette_ind;
+        art.palette = sprite.palette;
+        art.entities.emplace_back(entity);
+
+        // One 16x16 metasprite makes up our sprite
+        sprite_ind++;
     };
 
     // a complicated way of generating shrimp "evenly" between 4 quadrants in the image
@@ -250,62 +172,77 @@ ShrimpMode::ShrimpMode() {
 
     // --------- Create shrimp
     // !!TODO: read image, don't use original palette...
-    shrimp_start = {palette_ind, tile_ind, sprite_ct};
+    shrimp_start = {palette_ind, sprite_ct};
     for (uint8_t shrimp_ct = sprite_ct; shrimp_ct < 7; shrimp_ct++) {
         uint8_t shrimp_x = coordinates[2 * shrimp_ct];
         uint8_t shrimp_y = coordinates[(2 * shrimp_ct) + 1];
 
-        std::string shrimp_png;
+        std::string shrimp_name;
         uint8_t shrimp_result = shrimp_ct / 4;
-        if (shrimp_result == 0)      shrimp_png = "images/shrimp_top.png";
-        else                         shrimp_png = "images/shrimp_right.png";
+        if (shrimp_result == 0)      shrimp_name = "shrimp_top";
+        else                         shrimp_name = "shrimp_right";
     
-        configure_sprite(shrimp_png.c_str(), Shrimp, false, palette_ind, tile_ind, sprite_ind, shrimp_x, shrimp_y);
-        fix_sprite_tiles(shrimp_x, shrimp_y);
+        configure_sprite(shrimp_name, Shrimp, false, palette_ind, sprite_ind, shrimp_x, shrimp_y);
     }
     sprite_ct += 7;
     palette_ind++;
 
     // --------- Create plants
-    plant_start = {palette_ind, tile_ind, sprite_ct};
+    plant_start = {palette_ind, sprite_ct};
     for (uint8_t plant_ct = sprite_ct; plant_ct < (sprite_ct + 4); plant_ct++) {
         uint8_t plant_x = coordinates[2 * plant_ct];
         uint8_t plant_y = coordinates[(2 * plant_ct) + 1];
     
-        configure_sprite("images/plant.png", Plant, false, palette_ind, tile_ind, sprite_ind, plant_x, plant_y);
-        fix_sprite_tiles(plant_x, plant_y);
+        configure_sprite("plant", Plant, false, palette_ind, sprite_ind, plant_x, plant_y);
     }
     sprite_ct += 4;
     palette_ind++;
 
     // --------- Create medicine
-    med_start = {palette_ind, tile_ind, sprite_ct};
+    med_start = {palette_ind, sprite_ct};
     uint8_t med_x = coordinates[2 * sprite_ct];
     uint8_t med_y = coordinates[(2 * sprite_ct) + 1];
-    configure_sprite("images/pepto.png", Medicine, false, palette_ind, tile_ind, sprite_ind, med_x, med_y);
-    fix_sprite_tiles(med_x, med_y);
+    configure_sprite("pepto", Medicine, false, palette_ind, sprite_ind, med_x, med_y);
     palette_ind++;
     sprite_ct += 1;
 
     // ------ FLAMINGOS
 
 
-    flamingo_start = {palette_ind, tile_ind, sprite_ct};
-    configure_sprite("images/flamingo_no_pink.png", Flamingo, false, palette_ind, tile_ind, sprite_ind, 0, 0);
+    flamingo_start = {palette_ind, sprite_ct};
+    configure_sprite("flamingo_no_pink", Flamingo, false, palette_ind, sprite_ind, 0, 0);
     palette_ind++;
 
-    configure_sprite("images/flamingo_little_pink.png", Flamingo, false, palette_ind, tile_ind, sprite_ind, 0, 0);
+    configure_sprite("flamingo_little_pink", Flamingo, false, palette_ind, sprite_ind, 0, 0);
     palette_ind++;
 
-    configure_sprite("images/flamingo_most_pink.png", Flamingo, false, palette_ind, tile_ind, sprite_ind, 0, 0);
+    configure_sprite("flamingo_most_pink", Flamingo, false, palette_ind, sprite_ind, 0, 0);
     palette_ind++;
 
-    configure_sprite("images/flamingo_sick.png", Flamingo, false, palette_ind, tile_ind, sprite_ind, 0, 0);
+    configure_sprite("flamingo_sick", Flamingo, false, palette_ind, sprite_ind, 0, 0);
+
+    // Everything the player can bump into goes in the collision grid
+    for (uint32_t i = shrimp_start.first_sprite_ind; i < flamingo_start.first_sprite_ind; i++) {
+        collision_grid.insert(i, entity_box(i));
+    }
+    collision_hits.reserve(entities.size());    // so update() never allocates
+
+#ifndef EMBED_SPRITES
+    // Watch the source images (images/ is next to dist/ when running from a checkout);
+    // builds with embedded sprites are for release, so they never look for them
+    art_watcher.reset(new ArtWatcher(data_path("../images")));
+    if (!art_watcher->watching()) art_watcher.reset();     // no images/ (or no inotify): nothing to swap in
+#endif
 }
 
 ShrimpMode::~ShrimpMode() {
 }
 
+CollisionGrid::Box ShrimpMode::entity_box(uint32_t entity) const {
+    glm::vec2 at = glm::vec2(entities.x[entity], entities.y[entity]);
+    return CollisionGrid::Box{at, at + 16.f};
+}
+
 bool ShrimpMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size) {
 
 	if (evt.type == SDL_KEYDOWN) {
@@ -345,8 +282,63 @@ bool ShrimpMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_siz
 	return false;
 }
 
+void ShrimpMode::reload_art(ArtWatcher::Reload const &reload) {
+    auto slot = art_slots.find(reload.name);
+    if (slot == art_slots.end()) return;       // not an image this mode uses
+    ArtSlot &art = slot->second;
+
+    // Other art drawn from the same block (identical art is shared) or palette (the shrimp share one)
+    bool block_shared = false;
+    bool palette_shared = false;
+    for (auto const &other : art_slots) {
+        if (&other.second == &art) continue;
+        block_shared = block_shared || other.second.tile_index == art.tile_index;
+        palette_shared = palette_shared || other.second.palette_index == art.palette_index;
+    }
+    bool palette_changed = art.palette != reload.sprite.palette;
+
+    // A shared palette can't change without recoloring the other sprites (and there are no spare palettes)
+    if (palette_changed && palette_shared) {
+        std::cerr << "WARNING: not reloading '" << reload.name << "': its palette is shared with other sprites, so its colors can't change until restart." << std::endl;
+        return;
+    }
+
+    if (!block_shared) {
+        // Only this art uses the block, so rewrite it in place (only tiles that changed get marked dirty)
+        tile_allocator->update_block(art.tile_index, reload.sprite.tiles);
+    } else {
+        // Move this art to a block of its own (or one that already has the new art), so the sprites that
+        // shared the old block keep their tiles; unchanged art finds its own block, so nothing moves
+        uint8_t tile_index;
+        if (!tile_allocator->find_block(reload.sprite.tiles, &tile_index)) {
+            if (tile_allocator->blocks_used >= tile_allocator->block_count) {
+                std::cerr << "WARNING: not reloading '" << reload.name << "': its tiles are shared with other sprites, and there are no free tile blocks to give it its own." << std::endl;
+                return;
+            }
+            tile_index = tile_allocator->allocate_block(reload.sprite.tiles);
+        }
+        art.tile_index = tile_index;
+        for (uint32_t entity : art.entities) {
+            entities.tile_index[entity] = tile_index;
+        }
+    }
+
+    if (palette_changed) {
+        art.palette = reload.sprite.palette;
+        ppu.palette_table[art.palette_index] = art.palette;
+    }
+}
+
 void ShrimpMode::update(float elapsed) {
 
+    // Swap in any art that was edited (decoded + encoded off the main thread by art_watcher)
+    if (art_watcher) art_watcher->take_reloads(art_reloads);
+    for (auto const &reload : art_reloads) {
+        reload_art(reload);
+    }
+
+	player_was = player_at;
+
 	float PlayerSpeed = 30.0f + (score/2 * 25);    // goes faster when score increases
 	if (left.pressed) player_at.x -= PlayerSpeed * elapsed;
 	if (right.pressed) player_at.x += PlayerSpeed * elapsed;
@@ -359,37 +351,31 @@ void ShrimpMode::update(float elapsed) {
     if ((player_at.x + 16) >= PPU466::ScreenWidth)  player_at.x = PPU466::ScreenWidth - 16;
     if ((player_at.y + 16) >= PPU466::ScreenHeight) player_at.y = PPU466::ScreenHeight - 16;
 
-    // Handle collisions with scene
-    for (uint8_t i = shrimp_start.first_sprite_ind; i < flamingo_start.first_sprite_ind; i++) {
-        SpriteInfo &sinfo = sprite_infos[i];
-        std::string type;
-        if (sinfo.type == Shrimp) type = "Shrimp";
-        else if (sinfo.type == Plant) type = "Plant";
-        else if (sinfo.type == Medicine) type = "Medicine";
-        PPU466::Sprite sprite = ppu.sprites[sinfo.sprite_index];
-
-        glm::vec2 min = glm::max(glm::vec2(sprite.x, sprite.y), glm::vec2(player_at.x, player_at.y));
-        glm::vec2 max = glm::min(glm::vec2(sprite.x, sprite.y) + 16.f, glm::vec2(player_at.x, player_at.y) + 16.f);
+    // Handle collisions with scene: the grid only checks objects in the cells around the player
+    // (hits are handled in sprite order; eaten shrimp stay in the grid so they still end the loop)
+    collision_hits.clear();
+    collision_grid.query(CollisionGrid::Box{player_at, player_at + 16.f}, [this](uint32_t i) {
+        collision_hits.emplace_back(i);
+    });
+    std::sort(collision_hits.begin(), collision_hits.end());
 
-		if (min.x > max.x || min.y > max.y) continue; //if no overlap, no collision:
+    for (uint32_t i : collision_hits) {
+        uint8_t type = entities.type[i];
 
         // Handle collision based on type
-        if (sinfo.type == Shrimp) {
-            if (sinfo.consumed) break;      // Do nothing if consumed
+        if (type == Shrimp) {
+            if (entities.consumed(i)) break;      // Do nothing if consumed
             score++;
-            sinfo.consumed = true;
+            entities.set_consumed(i, true);
         } 
-        else if (sinfo.type == Plant) {     // Don't walk over plants, just undo step
+        else if (type == Plant) {     // Don't walk over plants, just undo step
             if (left.pressed)       player_at.x += PlayerSpeed * elapsed;
             else if (right.pressed) player_at.x -= PlayerSpeed * elapsed;
             else if (down.pressed)  player_at.y += PlayerSpeed * elapsed;
             else if (up.pressed)    player_at.y -= PlayerSpeed * elapsed;
         }
-        else if (sinfo.type == Medicine) {
-            for (uint8_t s = shrimp_start.first_sprite_ind; s < plant_start.first_sprite_ind; s++) {
-                SpriteInfo &shrimp_info = sprite_infos[s];
-                shrimp_info.consumed = false;
-            }
+        else if (type == Medicine) {
+            entities.set_consumed(shrimp_start.first_sprite_ind, plant_start.first_sprite_ind, false);
             score = 0;
         }  
     }
@@ -403,12 +389,8 @@ void ShrimpMode::update(float elapsed) {
     how_pink = ShrimpMode::Pinkness(std::max(score - 1, 0)  / 2);
 
     // Set visibility only for the current shade of flamingo
-    for (uint32_t flam_i = 0; flam_i < 4; flam_i++) {
-        uint32_t big_sprite_i = flamingo_start.first_sprite_ind + flam_i;
-        SpriteInfo &sprite_info = sprite_infos[big_sprite_i];
-        if (flam_i == how_pink) sprite_info.consumed = false;
-        else sprite_info.consumed = true;
-    }
+    entities.set_consumed(flamingo_start.first_sprite_ind, flamingo_start.first_sprite_ind + 4, true);
+    entities.set_consumed(flamingo_start.first_sprite_ind + how_pink, false);
 }
 
 void ShrimpMode::draw(glm::uvec2 const &drawable_size) {
@@ -418,47 +400,17 @@ void ShrimpMode::draw(glm::uvec2 const &drawable_size) {
 
     //--- set ppu state based on game state ---
 
-    // ---- Render all other sprites first
-    uint32_t sprite_i, big_sprite_i;
-    for (big_sprite_i = shrimp_start.first_sprite_ind; big_sprite_i < flamingo_start.first_sprite_ind; big_sprite_i++) {
-        SpriteInfo sprite_info = sprite_infos[big_sprite_i];
-        for (int32_t r = 0; r < sprite_tile_dim; r++) {
-            for (int32_t c = 0; c < sprite_tile_dim; c++) {
-                // "Hide" sprite if consumed, by changing its color palette
-                sprite_i = sprite_info.sprite_index + (r * sprite_tile_dim) + c;
-                if (sprite_info.consumed) ppu.sprites[sprite_i].attributes = 0;
-                else                      ppu.sprites[sprite_i].attributes = sprite_info.palette_index;
-            }
-        }
-    }
-
-    // ----- Flamingo (rendered last so it'll draw on top)
-    uint32_t row_offset, col_offset;
+    // ----- Flamingo follows the player
+    // update() runs at a fixed rate, so draw the player part way to its latest position
+    glm::vec2 at = glm::mix(player_was, player_at, update_alpha);
     for (uint32_t flam_i = 0; flam_i < 4; flam_i++) {
-        SpriteInfo flam_info = sprite_infos[flamingo_start.first_sprite_ind + flam_i];
-        if (flam_i == how_pink) {
-            for (int32_t r = 0; r < sprite_tile_dim; r++) {
-                for (int32_t c = 0; c < sprite_tile_dim; c++) {
-                    sprite_i = flam_info.sprite_index + (r * sprite_tile_dim) + c;
-                    row_offset = r * 8; // offset for y
-                    col_offset = c * 8; // offset for x
-                    ppu.sprites[sprite_i].x = int32_t(player_at.x) + col_offset;
-                    ppu.sprites[sprite_i].y = int32_t(player_at.y) + row_offset;
-                    ppu.sprites[sprite_i].index = flam_info.start_tile_index + (r * sprite_tile_dim) + c;
-                    ppu.sprites[sprite_i].attributes = flam_info.palette_index;
-                }
-            }
-        }
-        else {
-            for (int32_t r = 0; r < sprite_tile_dim; r++) {
-                for (int32_t c = 0; c < sprite_tile_dim; c++) {
-                    sprite_i = flam_info.sprite_index + (r * sprite_tile_dim) + c;
-                    ppu.sprites[sprite_i].attributes = 0;
-                }
-            }
-        }
+        entities.x[flamingo_start.first_sprite_ind + flam_i] = int16_t(at.x);
+        entities.y[flamingo_start.first_sprite_ind + flam_i] = int16_t(at.y);
     }
 
+    // ---- Copy every entity into its sprite (consumed/hidden ones go off screen)
+    entities.emit_sprites(ppu, 0, entities.size(), metasprite_bit);
+
 	//--- actually draw ---
 	ppu.draw(drawable_size);
 }
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include "Mode.hpp"
 #include "PPU466.hpp"
+#include "ArtWatcher.hpp"
+#include "TileAllocator.hpp"
+#include "CollisionGrid.hpp"
+#include "EntityStore.hpp"
 
 #include <glm/glm.hpp>
 
@@ -7,6 +11,9 @@
 #include <array>
 #include <deque>
 #include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
 
 struct ShrimpMode : Mode {
 	ShrimpMode();
@@ -28,16 +35,12 @@ struct ShrimpMode : Mode {
 
 	//player position:
 	glm::vec2 player_at = glm::vec2(PPU466::ScreenWidth/2-16.f, 0.0f);
+	//...and as of the previous update (draw interpolates between the two):
+	glm::vec2 player_was = player_at;
 
     //shrimp eaten:
     int8_t score = 0;
 
-    //----- helpers? will move later-----
-    void set_sprite_tiles(glm::uvec2 sprite_size, 
-                      std::vector< glm::u8vec4 > &sprite_data,
-                      PPU466::Palette &sprite_palette,
-                      uint8_t &tile_ind);
-
 
 	//----- drawing handled by PPU466 -----
 
@@ -49,22 +52,15 @@ struct ShrimpMode : Mode {
         Medicine = 3
     };
 
-    // Each sprite will consist of 2x2 tiles
-    const uint8_t sprite_tile_dim = 2;
-
-    // The hack: each sprite is represented by 2x2=4 smaller NES sprites
-    const uint8_t sprites_per_sprite = 4;
+    // Each sprite will consist of 2x2 tiles,
+    // drawn as one PPU metasprite, which shows a 2x2 block of tiles
+    // (set with this bit of the sprite attributes)
+    const uint8_t metasprite_bit = 0x40;
 
-    // So it'll make our lives easier to store some information per one of these larger sprites
-    struct SpriteInfo {
-        SpriteType type;                // what type of sprite is it
-        bool consumed = false;          // whether this sprite's been consumed (relevant for Shrimp, Medicine)
-        uint8_t palette_index;          // index of sprite's color palette
-        uint8_t start_tile_index;       // index into the tiles the sprite starts at
-        uint8_t sprite_index;            // index into the sprites the sprite starts at
-    };
-    std::vector< SpriteInfo > sprite_infos;
-    // The player (flamingo) will start at sprite 0
+    // Every object in the scene, one entity per 16x16 sprite (see EntityStore.hpp):
+    // type is a SpriteType; consumed is whether the sprite's been eaten (Shrimp) or is hidden (Flamingo);
+    // draw() copies the entities into ppu.sprites
+    EntityStore entities;
 
     typedef enum Pink {
         LittlePink = 0,
@@ -75,9 +71,9 @@ struct ShrimpMode : Mode {
     Pinkness how_pink = LittlePink;
 
     // Organize start indices for each type of sprite
+    // (each entity is drawn with the sprite of the same index, so first_sprite_ind is also the first entity)
     struct SpriteStarts {
         uint8_t first_palette_ind;
-        uint8_t first_tile_ind;
         uint8_t first_sprite_ind;
     };
     SpriteStarts flamingo_start;
@@ -85,6 +81,30 @@ struct ShrimpMode : Mode {
     SpriteStarts plant_start;
     SpriteStarts med_start;
 
+    // Broadphase for the player's collisions: holds the shrimp, plants, and medicine (by entity index)
+    // that can be hit (eaten shrimp included: hitting one ends that frame's collision checks)
+    CollisionGrid collision_grid = CollisionGrid(glm::uvec2(PPU466::ScreenWidth, PPU466::ScreenHeight));
+    std::vector< uint32_t > collision_hits;             // reused each update, to avoid allocating
+    CollisionGrid::Box entity_box(uint32_t entity) const;
+
+    // Where each sprite's art ended up, by name, so edited art can be swapped in while running
+    // (sprites with identical art share a block; reload_art gives an edited sprite its own block
+    //  rather than changing the others)
+    struct ArtSlot {
+        uint8_t tile_index = 0;         // bottom left tile of the sprite's 2x2 block
+        uint8_t palette_index = 0;
+        PPU466::Palette palette;        // this art's own colors (shared palettes hold whichever art loaded last)
+        std::vector< uint32_t > entities;   // entities drawn with this art
+    };
+    std::map< std::string, ArtSlot > art_slots;
+    std::unique_ptr< TileAllocator > tile_allocator;    // (kept for reloads)
+    void reload_art(ArtWatcher::Reload const &reload);
+
+    // Re-encodes images/*.png when they change (see ArtWatcher.hpp)
+    // (null when not watching, e.g. in EMBED_SPRITES builds)
+    std::unique_ptr< ArtWatcher > art_watcher;
+    std::vector< ArtWatcher::Reload > art_reloads;      // reused each update, to avoid allocating
+
     // const uint8_t other_sprites_start = 1;
     // const uint8_t plant_start = 9;
     // const uint8_t med_start = 14;
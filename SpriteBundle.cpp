@@ -0,0 +1,270 @@
+#include "SpriteBundle.hpp"
+
+#include "bitplanes.hpp"
+#include "read_write_chunk.hpp"
+#include "read_mapped_chunk.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+
+//Bundles are stored as four chunks:
+// "pal0" - one PPU466::Palette per sprite
+// "til0" - four PPU466::Tiles per sprite
+// "str0" - sprite names, one after another
+// "spr0" - one NameRange per sprite, locating its name in "str0"
+// (sprites are stored in the same order in "pal0", "til0", and "spr0")
+// (write_chunk pads so each chunk's data is aligned, so the loader can use a mapped file in place)
+struct NameRange {
+	uint32_t begin, end;
+};
+static_assert(sizeof(NameRange) == 8, "NameRange is packed.");
+
+SpriteBundle::SpriteBundle(std::string const &filename) {
+	//the chunks are used in place, straight out of the mapped file:
+	MappedFile file(filename);
+	size_t offset = 0;
+	ChunkSpan< PPU466::Palette > palettes = read_chunk< PPU466::Palette >(file, &offset, "pal0");
+	ChunkSpan< PPU466::Tile > tiles = read_chunk< PPU466::Tile >(file, &offset, "til0");
+	ChunkSpan< char > names = read_chunk< char >(file, &offset, "str0");
+	ChunkSpan< NameRange > ranges = read_chunk< NameRange >(file, &offset, "spr0");
+
+	if (palettes.size() != ranges.size() || tiles.size() != 4 * ranges.size()) {
+		throw std::runtime_error("Sprite bundle '" + filename + "' has mismatched chunk sizes.");
+	}
+
+	for (uint32_t i = 0; i < ranges.size(); ++i) {
+		NameRange const &range = ranges[i];
+		if (!(range.begin <= range.end && range.end <= names.size())) {
+			throw std::runtime_error("Sprite bundle '" + filename + "' has a name out of range.");
+		}
+		Sprite &sprite = sprites[std::string(names.begin() + range.begin, names.begin() + range.end)];
+		sprite.palette = palettes[i];
+		for (uint32_t t = 0; t < 4; ++t) {
+			sprite.tiles[t] = tiles[4 * i + t];
+		}
+	}
+}
+
+SpriteBundle::SpriteBundle(Embedded const &embedded) {
+	for (uint32_t i = 0; i < embedded.count; ++i) {
+		Sprite &sprite = sprites[embedded.names[i]];
+		sprite.palette = embedded.palettes[i];
+		for (uint32_t t = 0; t < 4; ++t) {
+			sprite.tiles[t] = embedded.tiles[4 * i + t];
+		}
+	}
+}
+
+SpriteBundle::Sprite const &SpriteBundle::lookup(std::string const &name) const {
+	auto f = sprites.find(name);
+	if (f == sprites.end()) {
+		throw std::runtime_error("Sprite '" + name + "' not in bundle.");
+	}
+	return f->second;
+}
+
+SpriteBundle::Sprite SpriteBundle::encode(glm::uvec2 size, std::vector< glm::u8vec4 > const &data) {
+	//Sprites should be of size 16x16 pixels => 2x2 tiles
+	if (size != glm::uvec2(16, 16) || data.size() != size.x * size.y) {
+		throw std::runtime_error("Sprite images should be 16x16.");
+	}
+
+	Sprite sprite;
+	sprite.palette = get_palette(size, data);
+	// Break up 16x16 image into 4 8x8 tiles
+	for (int32_t tile_y = 0; tile_y < 2; tile_y++) {
+		for (int32_t tile_x = 0; tile_x < 2; tile_x++) {
+			sprite.tiles[tile_x + 2 * tile_y] = set_tilebits(tile_y * 8, tile_x * 8, sprite.palette, size, data);
+		}
+	}
+	return sprite;
+}
+
+SpriteBundle::Sprite SpriteBundle::encode_indexed(IndexedPNG const &image) {
+	if (image.size != glm::uvec2(16, 16) || image.indices.size() != image.size.x * image.size.y) {
+		throw std::runtime_error("Sprite images should be 16x16.");
+	}
+
+	//map each palette entry to a sprite palette index, in the order the pixels first use them:
+	// (the same order get_palette finds colors in, so both paths agree)
+	Sprite sprite;
+	sprite.palette = {glm::u8vec4(0), glm::u8vec4(0), glm::u8vec4(0), glm::u8vec4(0)};
+	std::array< bool, 256 > mapped;
+	mapped.fill(false);
+	std::array< uint8_t, 256 > remap;
+	remap.fill(0);
+	uint32_t colors = 1; //index 0 is transparent
+	for (uint8_t i : image.indices) {
+		if (mapped[i]) continue;
+		mapped[i] = true;
+		if (i >= image.palette.size()) {
+			throw std::runtime_error("Sprite image uses index " + std::to_string(i) + ", which is past the end of its palette.");
+		}
+		glm::u8vec4 const &color = image.palette[i];
+		if (color.a == 0) continue; //transparent => 0
+		uint32_t c = 1;
+		while (c < colors && sprite.palette[c] != color) ++c;
+		if (c == colors) {
+			if (colors == 4) continue; //past the first three colors => 0
+			sprite.palette[colors++] = color;
+		}
+		remap[i] = uint8_t(c);
+	}
+
+	std::array< uint8_t, 16 * 16 > indices;
+	for (uint32_t p = 0; p < indices.size(); ++p) {
+		indices[p] = remap[image.indices[p]];
+	}
+	// Break up 16x16 indices into 4 8x8 tiles
+	for (uint32_t tile_y = 0; tile_y < 2; tile_y++) {
+		for (uint32_t tile_x = 0; tile_x < 2; tile_x++) {
+			sprite.tiles[tile_x + 2 * tile_y] = bitplanes_pack_tile(&indices[tile_y * 8 * 16 + tile_x * 8], 16);
+		}
+	}
+	return sprite;
+}
+
+SpriteBundle::Sprite SpriteBundle::encode(PNGImage const &image) {
+	if (image.indexed) return encode_indexed(*image.indexed);
+	return encode(image.size, image.data);
+}
+
+SpriteBundle::Sprite SpriteBundle::encode_png(std::string const &filename) {
+	try {
+		return encode(*load_png_cached(filename, LowerLeftOrigin));
+	} catch (std::exception const &e) {
+		throw std::runtime_error("'" + filename + "': " + e.what());
+	}
+}
+
+void SpriteBundle::save(std::string const &filename) const {
+	std::vector< PPU466::Palette > palettes;
+	std::vector< PPU466::Tile > tiles;
+	std::vector< char > names;
+	std::vector< NameRange > ranges;
+	for (auto const &named : sprites) {
+		palettes.emplace_back(named.second.palette);
+		tiles.insert(tiles.end(), named.second.tiles.begin(), named.second.tiles.end());
+		NameRange range;
+		range.begin = uint32_t(names.size());
+		names.insert(names.end(), named.first.begin(), named.first.end());
+		range.end = uint32_t(names.size());
+		ranges.emplace_back(range);
+	}
+
+	std::ofstream file(filename, std::ios::binary);
+	write_chunk("pal0", palettes, &file);
+	write_chunk("til0", tiles, &file);
+	write_chunk("str0", names, &file);
+	write_chunk("spr0", ranges, &file);
+	if (!file) {
+		throw std::runtime_error("Failed to write sprite bundle '" + filename + "'.");
+	}
+}
+
+void SpriteBundle::save_header(std::string const &filename, std::string const &symbol) const {
+	std::ofstream file(filename, std::ios::binary);
+	file << "#pragma once\n";
+	file << "\n";
+	file << "//generated by pack-sprites -- don't edit; re-run pack-sprites instead.\n";
+	file << "\n";
+	file << "#include \"SpriteBundle.hpp\"\n";
+	file << "\n";
+	file << "namespace " << symbol << "_data {\n";
+	file << std::hex << std::setfill('0');
+
+	auto byte = [&file](uint8_t b) {
+		file << "0x" << std::setw(2) << uint32_t(b);
+	};
+
+	file << "\nconstexpr char const *names[" << std::dec << sprites.size() << std::hex << "] = {\n";
+	for (auto const &named : sprites) {
+		//(names come from file names, but escape anything odd anyway)
+		file << "\t\"";
+		for (char c : named.first) {
+			if (c == '"' || c == '\\') file << '\\' << c;
+			else if (c < ' ' || c > '~') file << "\\x" << std::setw(2) << uint32_t(uint8_t(c)) << "\"\"";
+			else file << c;
+		}
+		file << "\",\n";
+	}
+	file << "};\n";
+
+	file << "\nconstexpr PPU466::Palette palettes[" << std::dec << sprites.size() << std::hex << "] = {\n";
+	for (auto const &named : sprites) {
+		file << "\tPPU466::Palette{{";
+		for (uint32_t c = 0; c < 4; ++c) {
+			glm::u8vec4 const &color = named.second.palette[c];
+			file << (c ? ", " : "") << "glm::u8vec4(";
+			byte(color.r); file << ", "; byte(color.g); file << ", "; byte(color.b); file << ", "; byte(color.a);
+			file << ")";
+		}
+		file << "}},\n";
+	}
+	file << "};\n";
+
+	file << "\nconstexpr PPU466::Tile tiles[" << std::dec << 4 * sprites.size() << std::hex << "] = {\n";
+	for (auto const &named : sprites) {
+		for (auto const &tile : named.second.tiles) {
+			file << "\tPPU466::Tile{{{";
+			for (uint32_t r = 0; r < 8; ++r) { file << (r ? ", " : ""); byte(tile.bit0[r]); }
+			file << "}}, {{";
+			for (uint32_t r = 0; r < 8; ++r) { file << (r ? ", " : ""); byte(tile.bit1[r]); }
+			file << "}}},\n";
+		}
+	}
+	file << "};\n";
+
+	file << "\n} //namespace " << symbol << "_data\n";
+	file << std::dec;
+	file << "\nconstexpr SpriteBundle::Embedded " << symbol << "{\n";
+	file << "\t" << sprites.size() << ", " << symbol << "_data::names, " << symbol << "_data::palettes, " << symbol << "_data::tiles\n";
+	file << "};\n";
+
+	if (!file) {
+		throw std::runtime_error("Failed to write sprite header '" + filename + "'.");
+	}
+}
+
+
+PPU466::Palette get_palette(glm::uvec2 size, std::vector< glm::u8vec4 > const &data) {
+	// Build palette from the first three colors to appear (entry 0 stays transparent)
+	PPU466::Palette palette = {glm::u8vec4(0), glm::u8vec4(0), glm::u8vec4(0), glm::u8vec4(0)};
+
+	uint32_t seen_color_inds = 1;
+	for (uint32_t i = 0; seen_color_inds < 4 && i < size.x * size.y; i++) {
+		glm::u8vec4 const &temp_color = data[i];
+		if (temp_color.a == 0) continue;    // any fully transparent pixel is color 0
+
+		// Check colors seen so far, adding the color if it's new
+		uint32_t c = 1;
+		while (c < seen_color_inds && palette[c] != temp_color) c++;
+		if (c == seen_color_inds) {
+			palette[seen_color_inds] = temp_color;
+			seen_color_inds++;
+		}
+	}
+
+	return palette;
+}
+
+PPU466::Tile set_tilebits(int32_t tile_row, int32_t tile_col,
+                     PPU466::Palette const &palette,
+                     glm::uvec2 size, std::vector< glm::u8vec4 > const &data) {
+	// Map each row of 8 pixels to palette indices, then pack indices into the tile's bit planes
+	// (a pixel matching several palette entries gets the OR of their indices)
+	std::array< uint8_t, 8 * 8 > indices;
+	for (int32_t pix_y = 0; pix_y < 8; pix_y++) {
+		glm::u8vec4 const *row = &data[((tile_row + pix_y) * size.x) + tile_col];
+		bitplanes_colors_to_indices(row, 8, palette, &indices[8 * pix_y]);
+		// Transparent pixels are always color 0 (they could also match unused, transparent palette entries;
+		// colors past the first three match nothing, so are already 0)
+		for (int32_t pix_x = 0; pix_x < 8; pix_x++) {
+			if (row[pix_x].a == 0) indices[8 * pix_y + pix_x] = 0;
+		}
+	}
+	PPU466::Tile tile = bitplanes_pack_tile(indices.data(), 8);
+	return tile;
+}
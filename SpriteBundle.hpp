@@ -0,0 +1,88 @@
+#pragma once
+
+/*
+ * A SpriteBundle holds 16x16 sprites already converted to PPU466 palettes and tiles.
+ *
+ * Bundles are built offline (see pack-sprites.cpp) from PNGs, so the game doesn't
+ *  need to decode or convert any images at startup.
+ *
+ * pack-sprites can also write a bundle as a C++ header of constexpr tables (see save_header),
+ *  which builds a SpriteBundle straight from read-only data compiled into the game.
+ *
+ */
+
+#include "PPU466.hpp"
+#include "load_save_png.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+
+struct SpriteBundle {
+	SpriteBundle() = default;
+	//load a bundle written by save(); throws on error:
+	SpriteBundle(std::string const &filename);
+
+	//a bundle compiled into the program (as written by save_header):
+	struct Embedded {
+		uint32_t count;
+		char const * const *names; //[count]
+		PPU466::Palette const *palettes; //[count]
+		PPU466::Tile const *tiles; //[4 * count], four per sprite as in Sprite::tiles
+	};
+	SpriteBundle(Embedded const &embedded);
+
+	//Each sprite is a 16x16 image, stored as a palette and a 2x2 block of tiles:
+	struct Sprite {
+		PPU466::Palette palette;
+		//tiles, in the order [bottom left, bottom right, top left, top right]:
+		std::array< PPU466::Tile, 4 > tiles;
+	};
+
+	//sprites by name (pack-sprites uses the image's file name without the extension):
+	std::map< std::string, Sprite > sprites;
+
+	//look up a sprite by name; throws if it isn't in the bundle:
+	Sprite const &lookup(std::string const &name) const;
+
+	//Every way of encoding follows the same rules, so the same art gives the same sprite
+	// whether it was saved as an RGBA or a palette-type PNG:
+	// - pixels with alpha == 0 are transparent (index 0), whatever their other channels
+	// - the other colors get indices 1-3 in the order they first appear (bottom row first, left to right)
+	// - any colors after the first three are dropped (drawn as transparent) -- e.g., the flamingo
+	//    images rely on this to leave out their beaks
+
+	//build a sprite from a 16x16 image (with lower-left origin); throws if the image is the wrong size:
+	static Sprite encode(glm::uvec2 size, std::vector< glm::u8vec4 > const &data);
+
+	//build a sprite from a 16x16 palette-type image (with lower-left origin) by remapping its indices;
+	// throws if the image is the wrong size, or uses an index past the end of its palette:
+	static Sprite encode_indexed(IndexedPNG const &image);
+
+	//build a sprite from a decoded 16x16 PNG (with lower-left origin); throws on error:
+	// (palette-type images go through encode_indexed, so their colors never need to be rediscovered)
+	static Sprite encode(PNGImage const &image);
+
+	//load a 16x16 PNG (through load_png_cached) and build a sprite from it; throws on error:
+	static Sprite encode_png(std::string const &filename);
+
+	//write the bundle (as a sequence of chunks -- see read_write_chunk.hpp); throws on error:
+	void save(std::string const &filename) const;
+
+	//write the bundle as a header defining 'constexpr SpriteBundle::Embedded <symbol>'; throws on error:
+	// (the tables have internal linkage, so include the header in just one .cpp)
+	void save_header(std::string const &filename, std::string const &symbol) const;
+};
+
+//The steps of SpriteBundle::encode:
+
+//find the first three colors of an image, as described above SpriteBundle::encode; palette[0] is always transparent:
+PPU466::Palette get_palette(glm::uvec2 size, std::vector< glm::u8vec4 > const &data);
+
+//convert the 8x8 block of an image starting at (tile_col, tile_row) to a tile using palette:
+PPU466::Tile set_tilebits(int32_t tile_row, int32_t tile_col,
+                     PPU466::Palette const &palette,
+                     glm::uvec2 size, std::vector< glm::u8vec4 > const &data);
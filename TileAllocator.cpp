@@ -0,0 +1,92 @@
+#include "TileAllocator.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+uint64_t tile_hash(PPU466::Tile const &tile) {
+	//FNV-1a over the tile's bytes:
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (uint8_t b : tile.bit0) hash = (hash ^ b) * 0x100000001b3ULL;
+	for (uint8_t b : tile.bit1) hash = (hash ^ b) * 0x100000001b3ULL;
+	return hash;
+}
+
+TileAllocator::TileAllocator(PPU466 &ppu_, uint32_t block_count_) : ppu(ppu_), block_count(block_count_) {
+	if (block_count > 64) {
+		throw std::runtime_error("The tile table only has room for 64 2x2 blocks.");
+	}
+}
+
+namespace {
+	//block hash combines the four tile hashes (in order, since the same tiles in another order is different art):
+	uint64_t block_hash(std::array< PPU466::Tile, 4 > const &tiles) {
+		uint64_t hash = 0;
+		for (auto const &tile : tiles) {
+			hash = (hash * 0x9e3779b97f4a7c15ULL) ^ tile_hash(tile);
+		}
+		return hash;
+	}
+
+	//the tile table index of tile t of the block starting at tile_index:
+	uint8_t block_tile(uint8_t tile_index, uint32_t t) {
+		return uint8_t(tile_index + (t % 2) + (t / 2) * 16);
+	}
+}
+
+bool TileAllocator::find_block(std::array< PPU466::Tile, 4 > const &tiles, uint8_t *tile_index_) const {
+	uint64_t hash = block_hash(tiles);
+	for (uint32_t block = 0; block < blocks_used; ++block) {
+		if (block_hashes[block] != hash) continue;
+		bool same = true;
+		for (uint32_t t = 0; t < 4; ++t) {
+			if (std::memcmp(&ppu.tile_table[block_tile(tile_index(block), t)], &tiles[t], sizeof(PPU466::Tile)) != 0) {
+				same = false;
+				break;
+			}
+		}
+		if (same) {
+			*tile_index_ = tile_index(block);
+			return true;
+		}
+	}
+	return false;
+}
+
+uint8_t TileAllocator::allocate_block(std::array< PPU466::Tile, 4 > const &tiles) {
+	//re-use an existing block with the same tiles:
+	uint8_t found;
+	if (find_block(tiles, &found)) {
+		++blocks_shared;
+		return found;
+	}
+
+	//otherwise, write the tiles to a new block:
+	if (blocks_used >= block_count) {
+		throw std::runtime_error("Out of tile blocks (all " + std::to_string(block_count) + " used).");
+	}
+	uint32_t block = blocks_used++;
+	for (uint32_t t = 0; t < 4; ++t) {
+		ppu.tile_table[block_tile(tile_index(block), t)] = tiles[t];
+		ppu.mark_tile_dirty(block_tile(tile_index(block), t));
+	}
+	block_hashes[block] = block_hash(tiles);
+	return tile_index(block);
+}
+
+uint32_t TileAllocator::update_block(uint8_t tile_index_, std::array< PPU466::Tile, 4 > const &tiles) {
+	uint32_t block = block_of(tile_index_);
+	assert(block < blocks_used && tile_index(block) == tile_index_);
+
+	uint32_t changed = 0;
+	for (uint32_t t = 0; t < 4; ++t) {
+		uint8_t index = block_tile(tile_index_, t);
+		if (std::memcmp(&ppu.tile_table[index], &tiles[t], sizeof(PPU466::Tile)) == 0) continue;
+		ppu.tile_table[index] = tiles[t];
+		ppu.mark_tile_dirty(index);
+		++changed;
+	}
+	if (changed) block_hashes[block] = block_hash(tiles);
+	return changed;
+}
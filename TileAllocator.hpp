@@ -0,0 +1,56 @@
+#pragma once
+
+/*
+ * TileAllocator hands out 2x2 tile blocks (for 16x16 metasprites) in a PPU466's tile table,
+ *  re-using a block whenever the same tiles have already been allocated.
+ *
+ * Tiles are hashed on their 16 encoded bytes, so identical art only costs pattern memory once,
+ *  no matter how many times it is loaded.
+ *
+ */
+
+#include "PPU466.hpp"
+
+#include <array>
+
+//hash of a tile's bit planes:
+uint64_t tile_hash(PPU466::Tile const &tile);
+
+struct TileAllocator {
+	//uses blocks 0 .. block_count-1 of ppu's tile table; block b is the 2x2 tiles starting at tile_index(b)
+	// (e.g., pass 63 to keep the last block -- including tile 255 -- for other uses)
+	TileAllocator(PPU466 &ppu, uint32_t block_count = 64);
+
+	//tiles in the order [bottom left, bottom right, top left, top right] (as in SpriteBundle::Sprite);
+	//returns the tile table index of the block (its bottom left tile) -- suitable for a metasprite's index.
+	//throws if the block is new and there are no blocks left.
+	uint8_t allocate_block(std::array< PPU466::Tile, 4 > const &tiles);
+
+	//look for an already-allocated block with these tiles; returns false if there isn't one:
+	bool find_block(std::array< PPU466::Tile, 4 > const &tiles, uint8_t *tile_index) const;
+
+	//rewrite the tiles of the block at 'tile_index' in place (e.g., when its art is edited);
+	// only tiles that actually change are written and marked dirty. returns the number of tiles changed.
+	// (every sprite using the block changes too, so only do this to blocks with one user)
+	uint32_t update_block(uint8_t tile_index, std::array< PPU466::Tile, 4 > const &tiles);
+
+	//tile table index of the bottom left tile of block b:
+	static uint8_t tile_index(uint32_t block) {
+		return uint8_t((block % 8) * 2 + (block / 8) * 32);
+	}
+	//...and the block whose bottom left tile is tile_index:
+	static uint32_t block_of(uint8_t tile_index) {
+		return (tile_index % 16) / 2 + (tile_index / 32) * 8;
+	}
+
+	uint32_t blocks_used = 0; //distinct blocks written to the tile table
+	uint32_t blocks_shared = 0; //allocations that re-used an existing block
+
+	PPU466 &ppu;
+	uint32_t block_count;
+
+private:
+	//hash of each used block (hashes can collide, so matches are checked against the tile table):
+	// (a fixed array rather than a map, so allocating or updating a block while the game runs never hits the heap)
+	std::array< uint64_t, 64 > block_hashes{};
+};
@@ -0,0 +1,113 @@
+#include "TileSheet.hpp"
+
+#include "bitplanes.hpp"
+#include "load_save_png.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+uint32_t import_tile_sheet(PPU466 &ppu, uint8_t first_tile, PPU466::Palette const &palette,
+	glm::uvec2 size, std::vector< glm::u8vec4 > const &data) {
+
+	if (size.x % 8 != 0 || size.y % 8 != 0 || data.size() != size.x * size.y) {
+		throw std::runtime_error("Tile sheet size (" + std::to_string(size.x) + "x" + std::to_string(size.y) + ") is not a multiple of 8x8.");
+	}
+	const uint32_t tiles_x = size.x / 8;
+	const uint32_t tiles_y = size.y / 8;
+	if (tiles_x == 0 || tiles_y == 0) return 0;
+	if (first_tile % 16 + tiles_x > 16 || first_tile + 16 * (tiles_y - 1) + tiles_x > ppu.tile_table.size()) {
+		throw std::runtime_error("Tile sheet (" + std::to_string(tiles_x) + "x" + std::to_string(tiles_y) + " tiles) doesn't fit in the tile table starting at tile " + std::to_string(first_tile) + ".");
+	}
+
+	//each band of eight pixel rows is contiguous in the image, so it converts to indices in one call,
+	// then each tile is packed straight out of the band:
+	// (a band is at most 16 tiles wide, so this fits on the stack)
+	std::array< uint8_t, 128 * 8 > band;
+	for (uint32_t ty = 0; ty < tiles_y; ++ty) {
+		bitplanes_colors_to_indices(&data[ty * 8 * size.x], 8 * size.x, palette, band.data());
+		for (uint32_t tx = 0; tx < tiles_x; ++tx) {
+			uint8_t index = uint8_t(first_tile + 16 * ty + tx);
+			ppu.tile_table[index] = bitplanes_pack_tile(&band[tx * 8], size.x);
+			ppu.mark_tile_dirty(index);
+		}
+	}
+
+	return tiles_x * tiles_y;
+}
+
+std::vector< SpriteBundle::Sprite > import_sprite_sheet(glm::uvec2 size, std::vector< glm::u8vec4 > const &data) {
+	if (size.x % 16 != 0 || size.y % 16 != 0 || data.size() != size.x * size.y) {
+		throw std::runtime_error("Sprite sheet size (" + std::to_string(size.x) + "x" + std::to_string(size.y) + ") is not a multiple of 16x16.");
+	}
+	const uint32_t cells_x = size.x / 16;
+	const uint32_t cells_y = size.y / 16;
+	std::vector< SpriteBundle::Sprite > sprites(cells_x * cells_y);
+
+	//each cell is copied out and encoded just like a single-sprite image would be,
+	// so a sheet follows the same palette rules (see SpriteBundle::encode):
+	std::vector< glm::u8vec4 > cell(16 * 16);
+	for (uint32_t cy = 0; cy < cells_y; ++cy) {
+		for (uint32_t cx = 0; cx < cells_x; ++cx) {
+			for (uint32_t row = 0; row < 16; ++row) {
+				glm::u8vec4 const *from = &data[(cy * 16 + row) * size.x + cx * 16];
+				std::copy(from, from + 16, &cell[row * 16]);
+			}
+			//(image rows count up from the bottom, sprites count down from the top)
+			sprites[cx + (cells_y - 1 - cy) * cells_x] = SpriteBundle::encode(glm::uvec2(16, 16), cell);
+		}
+	}
+
+	return sprites;
+}
+
+std::string sprite_sheet_names_file(std::string const &png_filename) {
+	std::string base = png_filename;
+	if (base.size() > 4 && base.substr(base.size() - 4) == ".png") base = base.substr(0, base.size() - 4);
+	return base + ".txt";
+}
+
+bool is_sprite_sheet(std::string const &png_filename) {
+	return bool(std::ifstream(sprite_sheet_names_file(png_filename)));
+}
+
+std::vector< std::pair< std::string, SpriteBundle::Sprite > > load_sprite_sheet(std::string const &png_filename) {
+	std::string names_filename = sprite_sheet_names_file(png_filename);
+	std::ifstream names_file(names_filename);
+	if (!names_file) {
+		throw std::runtime_error("Failed to open sprite sheet names '" + names_filename + "'.");
+	}
+	std::vector< std::string > names;
+	std::string line;
+	while (std::getline(names_file, line)) {
+		//trim whitespace (including the '\r' of files with windows line endings):
+		size_t begin = line.find_first_not_of(" \t\r");
+		size_t end = line.find_last_not_of(" \t\r");
+		names.emplace_back(begin == std::string::npos ? std::string() : line.substr(begin, end + 1 - begin));
+	}
+
+	std::shared_ptr< PNGImage const > image = load_png_cached(png_filename, LowerLeftOrigin);
+	std::vector< SpriteBundle::Sprite > sprites;
+	try {
+		sprites = import_sprite_sheet(image->size, image->data);
+	} catch (std::exception const &e) {
+		throw std::runtime_error("'" + png_filename + "': " + e.what());
+	}
+	if (names.size() > sprites.size()) {
+		throw std::runtime_error("'" + names_filename + "' lists " + std::to_string(names.size()) + " sprites, but '" + png_filename + "' only has " + std::to_string(sprites.size()) + ".");
+	}
+
+	std::vector< std::pair< std::string, SpriteBundle::Sprite > > ret;
+	std::set< std::string > seen;
+	for (uint32_t i = 0; i < names.size(); ++i) {
+		if (names[i].empty() || names[i] == "-") continue;
+		if (!seen.insert(names[i]).second) {
+			throw std::runtime_error("'" + names_filename + "' lists '" + names[i] + "' more than once.");
+		}
+		ret.emplace_back(names[i], sprites[i]);
+	}
+	return ret;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+/*
+ * Import whole sheets of art in one pass, instead of one small image at a time.
+ *
+ * import_tile_sheet writes a sheet of 8x8 tiles straight into a PPU466's tile table.
+ *  The sheet is laid out like the tile table itself: 16 tiles per row, with rows counted
+ *  from the bottom of the image. So tile (x,y) of the sheet becomes tile table entry
+ *  first_tile + 16*y + x, and 16x16 sprites drawn at even tile positions are ready to
+ *  use as metasprites (their tiles are at index, index+1, index+16, index+17).
+ *
+ * import_sprite_sheet slices a sheet of 16x16 sprites (any number of them) into
+ *  SpriteBundle sprites, each with its own palette; load_sprite_sheet does the same
+ *  for a PNG, naming the sprites from a list stored next to it. pack-sprites
+ *  (and ArtWatcher) accept sheets like this alongside single-sprite PNGs.
+ *
+ */
+
+#include "PPU466.hpp"
+#include "SpriteBundle.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+//write the tiles of a sheet (with lower-left origin) into ppu.tile_table, using one palette for every pixel:
+// - pixels that match no palette entry become index 0 (transparent)
+// - size must be a multiple of 8 in each dimension, and the sheet's tiles must fit in the table
+//    starting at first_tile without wrapping rows (throws otherwise)
+// - the written tiles are marked dirty
+//returns the number of tiles written.
+uint32_t import_tile_sheet(PPU466 &ppu, uint8_t first_tile, PPU466::Palette const &palette,
+	glm::uvec2 size, std::vector< glm::u8vec4 > const &data);
+
+//slice a sheet of 16x16 sprites (with lower-left origin) into sprites, each with its own palette:
+// - each cell is encoded by SpriteBundle::encode, so a sprite comes out just as it would from its own
+//    16x16 image (same palette rules)
+// - sprites are numbered like reading text: left to right along the top row of the sheet, then the next row down
+// - size must be a multiple of 16 in each dimension (throws otherwise)
+std::vector< SpriteBundle::Sprite > import_sprite_sheet(glm::uvec2 size, std::vector< glm::u8vec4 > const &data);
+
+//Sprite sheet PNGs come with a list of names: a text file at the same path, but ending in '.txt'
+// instead of '.png' (e.g., 'art/sheet.txt' for 'art/sheet.png').
+// it has one line per sprite, in the order import_sprite_sheet numbers them; a line that is empty
+//  or just '-' leaves that sprite out, and sprites after the last line are left out.
+
+//the names file for a sheet:
+std::string sprite_sheet_names_file(std::string const &png_filename);
+//is 'png_filename' a sprite sheet? (i.e., does it have a names file)
+bool is_sprite_sheet(std::string const &png_filename);
+
+//load a sprite sheet PNG (through load_png_cached) and its names; returns (name, sprite) pairs in sheet order.
+// throws on error (including more names than the sheet has sprites, or a name listed twice).
+std::vector< std::pair< std::string, SpriteBundle::Sprite > > load_sprite_sheet(std::string const &png_filename);
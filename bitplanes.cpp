@@ -0,0 +1,345 @@
+#include "bitplanes.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <cassert>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BITPLANES_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+//MSVC allows any intrinsic in any function:
+#define BITPLANES_TARGET_SSE2
+#define BITPLANES_TARGET_AVX2
+#else
+//gcc/clang need to be told which functions may use which instructions:
+#define BITPLANES_TARGET_SSE2 __attribute__((target("sse2")))
+#define BITPLANES_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+//Portable versions -- these define the behavior the other versions must match:
+
+namespace {
+
+void expand_tile_portable(PPU466::Tile const &tile, uint8_t *indices, size_t stride) {
+	for (uint32_t y = 0; y < 8; ++y) {
+		for (uint32_t x = 0; x < 8; ++x) {
+			indices[y * stride + x] =
+				  ((tile.bit0[y] >> x) & 1)
+				| ((tile.bit1[y] >> x) & 1) << 1;
+		}
+	}
+}
+
+PPU466::Tile pack_tile_portable(uint8_t const *indices, size_t stride) {
+	PPU466::Tile tile;
+	for (uint32_t y = 0; y < 8; ++y) {
+		uint8_t bit0 = 0;
+		uint8_t bit1 = 0;
+		for (uint32_t x = 0; x < 8; ++x) {
+			bit0 |= (indices[y * stride + x] & 1) << x;
+			bit1 |= ((indices[y * stride + x] >> 1) & 1) << x;
+		}
+		tile.bit0[y] = bit0;
+		tile.bit1[y] = bit1;
+	}
+	return tile;
+}
+
+void colors_to_indices_portable(glm::u8vec4 const *colors, size_t count, PPU466::Palette const &palette, uint8_t *indices) {
+	for (size_t i = 0; i < count; ++i) {
+		uint8_t index = 0;
+		for (uint8_t p = 0; p < 4; ++p) {
+			if (colors[i] == palette[p]) index |= p;
+		}
+		indices[i] = index;
+	}
+}
+
+} //namespace
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+//SSE2 versions -- two rows (16 pixels) per register:
+
+#ifdef BITPLANES_X86
+namespace {
+
+//colors are compared as packed 32-bit values:
+inline uint32_t pack_color(glm::u8vec4 const &c) {
+	uint32_t ret;
+	std::memcpy(&ret, static_cast< void const * >(&c), 4);
+	return ret;
+}
+
+//rows of eight indices are moved as 64-bit values:
+inline uint64_t load_row(uint8_t const *row) {
+	uint64_t ret;
+	std::memcpy(&ret, row, 8);
+	return ret;
+}
+
+//turn the bits of 'plane' (eight row bytes) into bytes that are 'value' where the bit is set, 0 elsewhere:
+// returns rows 0-1, 2-3, 4-5, 6-7 in out[0..3]
+BITPLANES_TARGET_SSE2
+void spread_sse2(std::array< uint8_t, 8 > const &plane, uint8_t value, __m128i out[4]) {
+	const __m128i bits = _mm_setr_epi8(1,2,4,8,16,32,64,-128, 1,2,4,8,16,32,64,-128);
+	const __m128i val = _mm_set1_epi8(char(value));
+	__m128i v = _mm_loadl_epi64(reinterpret_cast< __m128i const * >(plane.data()));
+	v = _mm_unpacklo_epi8(v, v); //each row byte x2
+	__m128i lo = _mm_unpacklo_epi16(v, v); //rows 0-3, each x4
+	__m128i hi = _mm_unpackhi_epi16(v, v); //rows 4-7, each x4
+	__m128i rows[4] = {
+		_mm_unpacklo_epi32(lo, lo), //rows 0-1, each x8
+		_mm_unpackhi_epi32(lo, lo), //rows 2-3
+		_mm_unpacklo_epi32(hi, hi), //rows 4-5
+		_mm_unpackhi_epi32(hi, hi), //rows 6-7
+	};
+	for (uint32_t i = 0; i < 4; ++i) {
+		out[i] = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(rows[i], bits), bits), val);
+	}
+}
+
+BITPLANES_TARGET_SSE2
+void expand_tile_sse2(PPU466::Tile const &tile, uint8_t *indices, size_t stride) {
+	__m128i b0[4], b1[4];
+	spread_sse2(tile.bit0, 1, b0);
+	spread_sse2(tile.bit1, 2, b1);
+	for (uint32_t i = 0; i < 4; ++i) {
+		__m128i rows = _mm_or_si128(b0[i], b1[i]);
+		_mm_storel_epi64(reinterpret_cast< __m128i * >(indices + (2*i+0) * stride), rows);
+		_mm_storel_epi64(reinterpret_cast< __m128i * >(indices + (2*i+1) * stride), _mm_unpackhi_epi64(rows, rows));
+	}
+}
+
+BITPLANES_TARGET_SSE2
+PPU466::Tile pack_tile_sse2(uint8_t const *indices, size_t stride) {
+	PPU466::Tile tile;
+	for (uint32_t i = 0; i < 4; ++i) {
+		__m128i rows = _mm_unpacklo_epi64(
+			_mm_loadl_epi64(reinterpret_cast< __m128i const * >(indices + (2*i+0) * stride)),
+			_mm_loadl_epi64(reinterpret_cast< __m128i const * >(indices + (2*i+1) * stride))
+		);
+		//move bit 0 / bit 1 of each byte to the byte's top bit and collect them with movemask:
+		uint32_t bit0 = uint32_t(_mm_movemask_epi8(_mm_slli_epi16(rows, 7)));
+		uint32_t bit1 = uint32_t(_mm_movemask_epi8(_mm_slli_epi16(rows, 6)));
+		tile.bit0[2*i+0] = uint8_t(bit0);
+		tile.bit0[2*i+1] = uint8_t(bit0 >> 8);
+		tile.bit1[2*i+0] = uint8_t(bit1);
+		tile.bit1[2*i+1] = uint8_t(bit1 >> 8);
+	}
+	return tile;
+}
+
+//palette indices (0-3 in each 32-bit lane) for four colors:
+BITPLANES_TARGET_SSE2
+inline __m128i match_sse2(__m128i colors, __m128i const pal[4]) {
+	__m128i index = _mm_setzero_si128();
+	for (uint32_t p = 1; p < 4; ++p) {
+		index = _mm_or_si128(index, _mm_and_si128(_mm_cmpeq_epi32(colors, pal[p]), _mm_set1_epi32(int32_t(p))));
+	}
+	return index;
+}
+
+BITPLANES_TARGET_SSE2
+void colors_to_indices_sse2(glm::u8vec4 const *colors, size_t count, PPU466::Palette const &palette, uint8_t *indices) {
+	__m128i pal[4];
+	for (uint32_t p = 0; p < 4; ++p) {
+		pal[p] = _mm_set1_epi32(int32_t(pack_color(palette[p])));
+	}
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i a = match_sse2(_mm_loadu_si128(reinterpret_cast< __m128i const * >(colors + i)), pal);
+		__m128i b = match_sse2(_mm_loadu_si128(reinterpret_cast< __m128i const * >(colors + i + 4)), pal);
+		__m128i packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_setzero_si128());
+		_mm_storel_epi64(reinterpret_cast< __m128i * >(indices + i), packed);
+	}
+	colors_to_indices_portable(colors + i, count - i, palette, indices + i);
+}
+
+} //namespace
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+//AVX2 versions -- four rows (32 pixels) per register:
+
+namespace {
+
+BITPLANES_TARGET_AVX2
+void spread_avx2(std::array< uint8_t, 8 > const &plane, uint8_t value, __m256i out[2]) {
+	const __m256i bits = _mm256_set1_epi64x(int64_t(0x8040201008040201ULL));
+	const __m256i val = _mm256_set1_epi8(char(value));
+	const __m256i v = _mm256_set1_epi64x(int64_t(load_row(plane.data())));
+	//(shuffle is per 128-bit lane, but every lane has all eight row bytes)
+	const __m256i rows[2] = {
+		_mm256_shuffle_epi8(v, _mm256_setr_epi8(0,0,0,0,0,0,0,0, 1,1,1,1,1,1,1,1, 2,2,2,2,2,2,2,2, 3,3,3,3,3,3,3,3)),
+		_mm256_shuffle_epi8(v, _mm256_setr_epi8(4,4,4,4,4,4,4,4, 5,5,5,5,5,5,5,5, 6,6,6,6,6,6,6,6, 7,7,7,7,7,7,7,7)),
+	};
+	for (uint32_t i = 0; i < 2; ++i) {
+		out[i] = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(rows[i], bits), bits), val);
+	}
+}
+
+BITPLANES_TARGET_AVX2
+void expand_tile_avx2(PPU466::Tile const &tile, uint8_t *indices, size_t stride) {
+	__m256i b0[2], b1[2];
+	spread_avx2(tile.bit0, 1, b0);
+	spread_avx2(tile.bit1, 2, b1);
+	for (uint32_t i = 0; i < 2; ++i) {
+		uint64_t rows[4];
+		_mm256_storeu_si256(reinterpret_cast< __m256i * >(rows), _mm256_or_si256(b0[i], b1[i]));
+		for (uint32_t r = 0; r < 4; ++r) {
+			std::memcpy(indices + (4*i+r) * stride, &rows[r], 8);
+		}
+	}
+}
+
+BITPLANES_TARGET_AVX2
+PPU466::Tile pack_tile_avx2(uint8_t const *indices, size_t stride) {
+	PPU466::Tile tile;
+	for (uint32_t i = 0; i < 2; ++i) {
+		__m256i rows = _mm256_setr_epi64x(
+			int64_t(load_row(indices + (4*i+0) * stride)),
+			int64_t(load_row(indices + (4*i+1) * stride)),
+			int64_t(load_row(indices + (4*i+2) * stride)),
+			int64_t(load_row(indices + (4*i+3) * stride))
+		);
+		uint32_t bit0 = uint32_t(_mm256_movemask_epi8(_mm256_slli_epi16(rows, 7)));
+		uint32_t bit1 = uint32_t(_mm256_movemask_epi8(_mm256_slli_epi16(rows, 6)));
+		for (uint32_t r = 0; r < 4; ++r) {
+			tile.bit0[4*i+r] = uint8_t(bit0 >> (8*r));
+			tile.bit1[4*i+r] = uint8_t(bit1 >> (8*r));
+		}
+	}
+	return tile;
+}
+
+BITPLANES_TARGET_AVX2
+void colors_to_indices_avx2(glm::u8vec4 const *colors, size_t count, PPU466::Palette const &palette, uint8_t *indices) {
+	__m256i pal[4];
+	for (uint32_t p = 0; p < 4; ++p) {
+		pal[p] = _mm256_set1_epi32(int32_t(pack_color(palette[p])));
+	}
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i c = _mm256_loadu_si256(reinterpret_cast< __m256i const * >(colors + i));
+		__m256i index = _mm256_setzero_si256();
+		for (uint32_t p = 1; p < 4; ++p) {
+			index = _mm256_or_si256(index, _mm256_and_si256(_mm256_cmpeq_epi32(c, pal[p]), _mm256_set1_epi32(int32_t(p))));
+		}
+		//narrow 32-bit lanes to bytes:
+		__m128i a = _mm256_castsi256_si128(index);
+		__m128i b = _mm256_extracti128_si256(index, 1);
+		__m128i packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_setzero_si128());
+		_mm_storel_epi64(reinterpret_cast< __m128i * >(indices + i), packed);
+	}
+	colors_to_indices_portable(colors + i, count - i, palette, indices + i);
+}
+
+bool cpu_has_avx2() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx) return false;
+	if ((_xgetbv(0) & 0x6) != 0x6) return false; //OS saves ymm registers
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+bool cpu_has_sse2() {
+#if defined(__x86_64__) || defined(_M_X64)
+	return true; //part of the x86-64 baseline
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+#else
+	return __builtin_cpu_supports("sse2");
+#endif
+}
+
+} //namespace
+#endif //BITPLANES_X86
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+//Dispatch:
+
+namespace {
+
+struct KernelTable {
+	BitplanesKernels kernels;
+	void (*expand_tile)(PPU466::Tile const &, uint8_t *, size_t);
+	PPU466::Tile (*pack_tile)(uint8_t const *, size_t);
+	void (*colors_to_indices)(glm::u8vec4 const *, size_t, PPU466::Palette const &, uint8_t *);
+};
+
+const KernelTable PortableTable{ BitplanesPortable, expand_tile_portable, pack_tile_portable, colors_to_indices_portable };
+#ifdef BITPLANES_X86
+const KernelTable SSE2Table{ BitplanesSSE2, expand_tile_sse2, pack_tile_sse2, colors_to_indices_sse2 };
+const KernelTable AVX2Table{ BitplanesAVX2, expand_tile_avx2, pack_tile_avx2, colors_to_indices_avx2 };
+#endif
+
+KernelTable const *supported_table(BitplanesKernels kernels) {
+	if (kernels == BitplanesPortable) return &PortableTable;
+#ifdef BITPLANES_X86
+	if (kernels == BitplanesSSE2 && cpu_has_sse2()) return &SSE2Table;
+	if (kernels == BitplanesAVX2 && cpu_has_avx2()) return &AVX2Table;
+#endif
+	return nullptr;
+}
+
+//(atomic so the kernels may be called from several threads)
+std::atomic< KernelTable const * > current_table(nullptr);
+
+KernelTable const &table() {
+	KernelTable const *ret = current_table.load(std::memory_order_acquire);
+	if (!ret) {
+		//first use -- pick the best supported kernels:
+		for (BitplanesKernels k : {BitplanesAVX2, BitplanesSSE2, BitplanesPortable}) {
+			ret = supported_table(k);
+			if (ret) break;
+		}
+		assert(ret);
+		current_table.store(ret, std::memory_order_release);
+	}
+	return *ret;
+}
+
+} //namespace
+
+void bitplanes_expand_tile(PPU466::Tile const &tile, uint8_t *indices, size_t stride) {
+	table().expand_tile(tile, indices, stride);
+}
+
+PPU466::Tile bitplanes_pack_tile(uint8_t const *indices, size_t stride) {
+	return table().pack_tile(indices, stride);
+}
+
+void bitplanes_colors_to_indices(glm::u8vec4 const *colors, size_t count, PPU466::Palette const &palette, uint8_t *indices) {
+	table().colors_to_indices(colors, count, palette, indices);
+}
+
+BitplanesKernels bitplanes_kernels() {
+	return table().kernels;
+}
+
+bool bitplanes_use_kernels(BitplanesKernels kernels) {
+	KernelTable const *t = supported_table(kernels);
+	if (!t) return false;
+	current_table.store(t, std::memory_order_release);
+	return true;
+}
+
+char const *bitplanes_kernels_name(BitplanesKernels kernels) {
+	if (kernels == BitplanesAVX2) return "avx2";
+	if (kernels == BitplanesSSE2) return "sse2";
+	return "portable";
+}
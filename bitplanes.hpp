@@ -0,0 +1,41 @@
+#pragma once
+
+/*
+ * Kernels for converting between PPU466 bit-plane tiles and per-pixel color indices.
+ *
+ * These work on whole 8-pixel rows at once and pick the fastest implementation the
+ *  CPU supports (AVX2, SSE2, or portable code) the first time they are called.
+ *
+ */
+
+#include "PPU466.hpp"
+
+#include <cstddef>
+
+//Expand a tile into 8x8 color indices (0-3):
+// row y of the tile is written to indices[y * stride + 0] ... indices[y * stride + 7]
+void bitplanes_expand_tile(PPU466::Tile const &tile, uint8_t *indices, size_t stride);
+
+//Pack 8x8 color indices into a tile (only the low two bits of each index are used):
+// row y of the tile is read from indices[y * stride + 0] ... indices[y * stride + 7]
+PPU466::Tile bitplanes_pack_tile(uint8_t const *indices, size_t stride);
+
+//Convert 'count' colors to palette indices:
+// each index is the bitwise OR of all palette entries that exactly match the color
+//  (so a color that matches no entry becomes index 0)
+void bitplanes_colors_to_indices(glm::u8vec4 const *colors, size_t count, PPU466::Palette const &palette, uint8_t *indices);
+
+
+//The implementations can be chosen explicitly (useful for benchmarking):
+enum BitplanesKernels {
+	BitplanesPortable,
+	BitplanesSSE2,
+	BitplanesAVX2,
+};
+
+//returns the kernels currently in use:
+BitplanesKernels bitplanes_kernels();
+//returns false (and changes nothing) if the CPU can't run the requested kernels:
+bool bitplanes_use_kernels(BitplanesKernels kernels);
+//human-readable name, e.g. for benchmark output:
+char const *bitplanes_kernels_name(BitplanesKernels kernels);
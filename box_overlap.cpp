@@ -0,0 +1,157 @@
+#include "box_overlap.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BOX_OVERLAP_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define BOX_OVERLAP_TARGET_SSE2
+#define BOX_OVERLAP_TARGET_AVX2
+#else
+#define BOX_OVERLAP_TARGET_SSE2 __attribute__((target("sse2")))
+#define BOX_OVERLAP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+//A 16x16 box at (x,y) overlaps the query box exactly when lo <= (x,y) <= hi:
+// (so every version of the test is just four integer compares per box)
+struct Range {
+	int16_t lo_x, hi_x;
+	int16_t lo_y, hi_y;
+};
+
+inline uint32_t count_bits(uint64_t bits) {
+	return uint32_t(std::bitset< 64 >(bits).count());
+}
+
+inline bool overlaps(int16_t x, int16_t y, Range const &r) {
+	return r.lo_x <= x && x <= r.hi_x && r.lo_y <= y && y <= r.hi_y;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+//Portable version -- defines the behavior the other versions must match:
+
+uint32_t overlap_portable(int16_t const *x, int16_t const *y, size_t count, Range const &r, uint64_t *hits) {
+	uint32_t total = 0;
+	for (size_t base = 0; base < count; base += 64) {
+		size_t n = std::min< size_t >(64, count - base);
+		uint64_t bits = 0;
+		for (size_t j = 0; j < n; ++j) {
+			if (overlaps(x[base + j], y[base + j], r)) bits |= uint64_t(1) << j;
+		}
+		hits[base / 64] = bits;
+		total += count_bits(bits);
+	}
+	return total;
+}
+
+#ifdef BOX_OVERLAP_X86
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+//SSE2 version -- 8 boxes per compare:
+
+BOX_OVERLAP_TARGET_SSE2
+uint32_t overlap_sse2(int16_t const *x, int16_t const *y, size_t count, Range const &r, uint64_t *hits) {
+	const __m128i lo_x = _mm_set1_epi16(r.lo_x);
+	const __m128i hi_x = _mm_set1_epi16(r.hi_x);
+	const __m128i lo_y = _mm_set1_epi16(r.lo_y);
+	const __m128i hi_y = _mm_set1_epi16(r.hi_y);
+
+	uint32_t total = 0;
+	for (size_t base = 0; base < count; base += 64) {
+		size_t n = std::min< size_t >(64, count - base);
+		uint64_t bits = 0;
+		size_t j = 0;
+		for (; j + 8 <= n; j += 8) {
+			__m128i xs = _mm_loadu_si128(reinterpret_cast< __m128i const * >(x + base + j));
+			__m128i ys = _mm_loadu_si128(reinterpret_cast< __m128i const * >(y + base + j));
+			__m128i miss = _mm_or_si128(
+				_mm_or_si128(_mm_cmpgt_epi16(lo_x, xs), _mm_cmpgt_epi16(xs, hi_x)),
+				_mm_or_si128(_mm_cmpgt_epi16(lo_y, ys), _mm_cmpgt_epi16(ys, hi_y))
+			);
+			//narrow 16-bit lanes to bytes, one mask bit per box:
+			uint32_t missed = uint32_t(_mm_movemask_epi8(_mm_packs_epi16(miss, miss))) & 0xff;
+			bits |= uint64_t(~missed & 0xff) << j;
+		}
+		for (; j < n; ++j) {
+			if (overlaps(x[base + j], y[base + j], r)) bits |= uint64_t(1) << j;
+		}
+		hits[base / 64] = bits;
+		total += count_bits(bits);
+	}
+	return total;
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+//AVX2 version -- 16 boxes per compare:
+
+BOX_OVERLAP_TARGET_AVX2
+uint32_t overlap_avx2(int16_t const *x, int16_t const *y, size_t count, Range const &r, uint64_t *hits) {
+	const __m256i lo_x = _mm256_set1_epi16(r.lo_x);
+	const __m256i hi_x = _mm256_set1_epi16(r.hi_x);
+	const __m256i lo_y = _mm256_set1_epi16(r.lo_y);
+	const __m256i hi_y = _mm256_set1_epi16(r.hi_y);
+
+	uint32_t total = 0;
+	for (size_t base = 0; base < count; base += 64) {
+		size_t n = std::min< size_t >(64, count - base);
+		uint64_t bits = 0;
+		size_t j = 0;
+		for (; j + 16 <= n; j += 16) {
+			__m256i xs = _mm256_loadu_si256(reinterpret_cast< __m256i const * >(x + base + j));
+			__m256i ys = _mm256_loadu_si256(reinterpret_cast< __m256i const * >(y + base + j));
+			__m256i miss = _mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpgt_epi16(lo_x, xs), _mm256_cmpgt_epi16(xs, hi_x)),
+				_mm256_or_si256(_mm256_cmpgt_epi16(lo_y, ys), _mm256_cmpgt_epi16(ys, hi_y))
+			);
+			//narrow 16-bit lanes to bytes (packing the two 128-bit halves keeps the boxes in order):
+			__m128i a = _mm256_castsi256_si128(miss);
+			__m128i b = _mm256_extracti128_si256(miss, 1);
+			uint32_t missed = uint32_t(_mm_movemask_epi8(_mm_packs_epi16(a, b))) & 0xffff;
+			bits |= uint64_t(~missed & 0xffff) << j;
+		}
+		for (; j < n; ++j) {
+			if (overlaps(x[base + j], y[base + j], r)) bits |= uint64_t(1) << j;
+		}
+		hits[base / 64] = bits;
+		total += count_bits(bits);
+	}
+	return total;
+}
+#endif //BOX_OVERLAP_X86
+
+//clamp a (whole-number) coordinate bound into int16_t range:
+int16_t clamp_coordinate(float f) {
+	return int16_t(std::max(-32768.0f, std::min(32767.0f, f)));
+}
+
+} //namespace
+
+uint32_t box_overlap_16x16(int16_t const *x, int16_t const *y, size_t count, glm::vec2 min, glm::vec2 max, uint64_t *hits) {
+	//box at (x,y) overlaps [min,max] when x <= max.x and x + 16 >= min.x (and the same for y);
+	// since x is a whole number, that is ceil(min.x - 16) <= x <= floor(max.x):
+	glm::vec2 lo = glm::vec2(std::ceil(min.x - 16.0f), std::ceil(min.y - 16.0f));
+	glm::vec2 hi = glm::vec2(std::floor(max.x), std::floor(max.y));
+	if (!(lo.x <= hi.x && lo.y <= hi.y) || lo.x > 32767.0f || lo.y > 32767.0f || hi.x < -32768.0f || hi.y < -32768.0f) {
+		//empty range (or NaN, or entirely outside int16_t coordinates), so nothing overlaps:
+		std::fill(hits, hits + (count + 63) / 64, uint64_t(0));
+		return 0;
+	}
+	Range r;
+	r.lo_x = clamp_coordinate(lo.x);
+	r.hi_x = clamp_coordinate(hi.x);
+	r.lo_y = clamp_coordinate(lo.y);
+	r.hi_y = clamp_coordinate(hi.y);
+
+	switch (bitplanes_kernels()) {
+#ifdef BOX_OVERLAP_X86
+		case BitplanesAVX2: return overlap_avx2(x, y, count, r, hits);
+		case BitplanesSSE2: return overlap_sse2(x, y, count, r, hits);
+#endif
+		default: return overlap_portable(x, y, count, r, hits);
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+/*
+ * Batched overlap tests between one query box and many 16x16 boxes (e.g., the entities of an EntityStore).
+ *
+ * Box corners are stored as separate arrays of 16-bit coordinates, so SIMD versions can test
+ *  8 (SSE2) or 16 (AVX2) boxes per compare. Like the bitplanes kernels, the implementation is
+ *  picked at runtime: these use whichever set bitplanes_kernels() reports, so bitplanes_use_kernels()
+ *  switches them too (see bitplanes.hpp).
+ *
+ */
+
+#include "bitplanes.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+//Test 'count' 16x16 boxes against the query box [min, max]:
+// box i covers [x[i], x[i]+16] x [y[i], y[i]+16]; boxes are closed, so boxes that just touch overlap (as in CollisionGrid).
+// writes a hit bitmask -- bit i%64 of hits[i/64] is set if box i overlaps -- so hits must hold (count + 63) / 64 words.
+// returns the number of overlapping boxes.
+uint32_t box_overlap_16x16(int16_t const *x, int16_t const *y, size_t count, glm::vec2 min, glm::vec2 max, uint64_t *hits);
+
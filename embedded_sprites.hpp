@@ -0,0 +1,82 @@
+#pragma once
+
+//generated by pack-sprites -- don't edit; re-run pack-sprites instead.
+
+#include "SpriteBundle.hpp"
+
+namespace embedded_sprites_data {
+
+constexpr char const *names[10] = {
+	"flamingo_little_pink",
+	"flamingo_most_pink",
+	"flamingo_no_pink",
+	"flamingo_sick",
+	"pepto",
+	"plant",
+	"shrimp_bottom",
+	"shrimp_left",
+	"shrimp_right",
+	"shrimp_top",
+};
+
+constexpr PPU466::Palette palettes[10] = {
+	PPU466::Palette{{glm::u8vec4(0x00, 0x00, 0x00, 0x00), glm::u8vec4(0xff, 0x96, 0xe7, 0xff), glm::u8vec4(0xff, 0x94, 0xe7, 0xff), glm::u8vec4(0x00, 0x00, 0x00, 0xff)}},
+	PPU466::Palette{{glm::u8vec4(0x00, 0x00, 0x00, 0x00), glm::u8vec4(0xff, 0x00, 0xe7, 0xff), glm::u8vec4(0x00, 0x00, 0x00, 0xff), glm::u8vec4(0xde, 0xb4, 0x2a, 0xff)}},
+	PPU466::Palette{{glm::u8vec4(0x00, 0x00, 0x00, 0x00), glm::u8vec4(0xff, 0xd3, 0xe7, 0xff), glm::u8vec4(0xff, 0xd1, 0xe7, 0xff), glm::u8vec4(0x00, 0x00, 0x00, 0xff)}},
+	PPU466::Palette{{glm::u8vec4(0x00, 0x00, 0x00, 0x00), glm::u8vec4(0xa7, 0xe7, 0x30, 0xff), glm::u8vec4(0xa5, 0xe6, 0x32, 0xff), glm::u8vec4(0x00, 0x00, 0x00, 0xff)}},
+	PPU466::Palette{{glm::u8vec4(0x00, 0x00, 0x00, 0x00), glm::u8vec4(0xe7, 0xdb, 0x24, 0xff), glm::u8vec4(0xff, 0x91, 0xae, 0xff), glm::u8vec4(0xe7, 0xdb, 0xff, 0xff)}},
+	PPU466::Palette{{glm::u8vec4(0x00, 0x00, 0x00, 0x00), glm::u8vec4(0x35, 0x2b, 0x09, 0xff), glm::u8vec4(0x33, 0x65, 0x19, 0xff), glm::u8vec4(0x11, 0x84, 0x2a, 0xff)}},
+	PPU466::Palette{{glm::u8vec4(0x00, 0x00, 0x00, 0x00), glm::u8vec4(0xfc, 0xa3, 0x75, 0xff), glm::u8vec4(0xfa, 0xcd, 0xb6, 0xff), glm::u8vec4(0xf6, 0x6d, 0x42, 0xff)}},
+	PPU466::Palette{{glm::u8vec4(0x00, 0x00, 0x00, 0x00), glm::u8vec4(0xfc, 0xa3, 0x75, 0xff), glm::u8vec4(0xfa, 0xcd, 0xb6, 0xff), glm::u8vec4(0xf6, 0x6d, 0x42, 0xff)}},
+	PPU466::Palette{{glm::u8vec4(0x00, 0x00, 0x00, 0x00), glm::u8vec4(0xfc, 0xa3, 0x75, 0xff), glm::u8vec4(0xf6, 0x6d, 0x42, 0xff), glm::u8vec4(0xfa, 0xcd, 0xb6, 0xff)}},
+	PPU466::Palette{{glm::u8vec4(0x00, 0x00, 0x00, 0x00), glm::u8vec4(0xfa, 0xcd, 0xb6, 0xff), glm::u8vec4(0xf6, 0x6d, 0x42, 0xff), glm::u8vec4(0xfc, 0xa3, 0x75, 0xff)}},
+};
+
+constexpr PPU466::Tile tiles[40] = {
+	PPU466::Tile{{{0x00, 0x40, 0x00, 0xc0, 0x00, 0x80, 0xc0, 0xe0}}, {{0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00}}},
+	PPU466::Tile{{{0x04, 0x04, 0x04, 0x04, 0x05, 0x8f, 0xff, 0xff}}, {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c}}},
+	PPU466::Tile{{{0xf0, 0xf0, 0x30, 0x60, 0xc4, 0xe4, 0xf8, 0x60}}, {{0x00, 0x00, 0x00, 0x00, 0x04, 0x04, 0x20, 0x00}}},
+	PPU466::Tile{{{0x7f, 0x3f, 0x1f, 0x00, 0x00, 0x00, 0x00, 0x00}}, {{0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}}},
+	PPU466::Tile{{{0x00, 0x40, 0x20, 0xc0, 0x00, 0x80, 0xc0, 0xe0}}, {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}}},
+	PPU466::Tile{{{0x04, 0x04, 0x04, 0x04, 0x05, 0x8f, 0xff, 0xc3}}, {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c}}},
+	PPU466::Tile{{{0xf0, 0xf0, 0x30, 0x60, 0xc0, 0xf8, 0xd8, 0x70}}, {{0x00, 0x00, 0x00, 0x00, 0x04, 0x1c, 0x20, 0x00}}},
+	PPU466::Tile{{{0x7d, 0x3f, 0x1f, 0x00, 0x00, 0x00, 0x00, 0x00}}, {{0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}}},
+	PPU466::Tile{{{0x00, 0x40, 0x00, 0xc0, 0x00, 0x80, 0xc0, 0xe0}}, {{0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00}}},
+	PPU466::Tile{{{0x04, 0x04, 0x04, 0x04, 0x05, 0x8f, 0xff, 0xff}}, {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c}}},
+	PPU466::Tile{{{0xf0, 0xf0, 0x30, 0x60, 0xc4, 0xe4, 0xf8, 0x60}}, {{0x00, 0x00, 0x00, 0x00, 0x04, 0x04, 0x20, 0x00}}},
+	PPU466::Tile{{{0x7f, 0x3f, 0x1f, 0x00, 0x00, 0x00, 0x00, 0x00}}, {{0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}}},
+	PPU466::Tile{{{0x08, 0x78, 0x40, 0x20, 0xa0, 0xf1, 0xff, 0xff}}, {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38}}},
+	PPU466::Tile{{{0x00, 0x02, 0x00, 0x03, 0x00, 0x01, 0x03, 0x07}}, {{0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00}}},
+	PPU466::Tile{{{0xfe, 0xfc, 0xfc, 0x0c, 0x04, 0x00, 0x00, 0x00}}, {{0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}}},
+	PPU466::Tile{{{0x0f, 0x0f, 0x0c, 0x06, 0x23, 0x27, 0x1f, 0x06}}, {{0x00, 0x00, 0x00, 0x00, 0x20, 0x20, 0x06, 0x00}}},
+	PPU466::Tile{{{0xf0, 0xf0, 0x90, 0x00, 0x00, 0x40, 0x40, 0xc0}}, {{0x00, 0x00, 0x60, 0xf0, 0xf0, 0xf0, 0xf0, 0xf0}}},
+	PPU466::Tile{{{0x0f, 0x0f, 0x0f, 0x0f, 0x0f, 0x06, 0x00, 0x03}}, {{0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x0f, 0x0f}}},
+	PPU466::Tile{{{0x40, 0xc0, 0x00, 0x00, 0x00, 0xe0, 0xe0, 0xe0}}, {{0xf0, 0xf0, 0xf0, 0xe0, 0xc0, 0x00, 0x00, 0x00}}},
+	PPU466::Tile{{{0x02, 0x03, 0x00, 0x00, 0x00, 0x07, 0x07, 0x07}}, {{0x0f, 0x0f, 0x0f, 0x07, 0x03, 0x00, 0x00, 0x00}}},
+	PPU466::Tile{{{0xf0, 0xe0, 0x00, 0x80, 0xc0, 0xe1, 0xb2, 0x9c}}, {{0x00, 0x00, 0xc0, 0xc0, 0xe0, 0xf3, 0xbe, 0x9c}}},
+	PPU466::Tile{{{0x07, 0x03, 0x00, 0x00, 0x01, 0x83, 0x46, 0x3c}}, {{0x00, 0x00, 0x01, 0x01, 0x03, 0xc7, 0x7e, 0x3c}}},
+	PPU466::Tile{{{0xc0, 0xa2, 0x9c, 0x80, 0x00, 0x00, 0x00, 0x00}}, {{0xe1, 0xbe, 0x9c, 0xc0, 0x20, 0x18, 0x00, 0x00}}},
+	PPU466::Tile{{{0x01, 0x42, 0x24, 0x18, 0x01, 0x02, 0x00, 0x00}}, {{0x03, 0x66, 0x3c, 0x19, 0x03, 0x0e, 0x10, 0x00}}},
+	PPU466::Tile{{{0xf0, 0x0c, 0x06, 0x09, 0x11, 0x21, 0x41, 0x81}}, {{0x00, 0xf0, 0xf8, 0xf6, 0xee, 0xde, 0xbe, 0x7e}}},
+	PPU466::Tile{{{0x0f, 0x10, 0x30, 0x48, 0x88, 0x88, 0xc8, 0xa4}}, {{0x00, 0x0f, 0x0f, 0x37, 0x77, 0x77, 0x37, 0x5b}}},
+	PPU466::Tile{{{0x01, 0x82, 0x7c, 0x00, 0xf8, 0xfc, 0xfc, 0xf8}}, {{0xfe, 0x7c, 0x00, 0x00, 0xf8, 0xfc, 0xfc, 0xf8}}},
+	PPU466::Tile{{{0x93, 0x8e, 0xc2, 0x41, 0x63, 0x3f, 0x1f, 0x07}}, {{0x6c, 0x70, 0x3c, 0x7f, 0x7f, 0x3f, 0x1f, 0x07}}},
+	PPU466::Tile{{{0xf8, 0x04, 0x06, 0x0a, 0x11, 0x21, 0x41, 0x81}}, {{0x00, 0xf8, 0xf8, 0xf4, 0xee, 0xde, 0xbe, 0x7e}}},
+	PPU466::Tile{{{0x01, 0x02, 0x64, 0xf4, 0xf4, 0xf4, 0xf4, 0xf2}}, {{0x00, 0x01, 0x63, 0xf3, 0xf3, 0xf3, 0xf3, 0xf1}}},
+	PPU466::Tile{{{0x01, 0x01, 0x81, 0x79, 0x06, 0x84, 0x48, 0xf0}}, {{0xfe, 0xfe, 0x7e, 0x86, 0xf8, 0x78, 0xb0, 0x00}}},
+	PPU466::Tile{{{0xf9, 0xf7, 0xe2, 0x62, 0x61, 0x30, 0x1c, 0x07}}, {{0xf8, 0xf8, 0xfd, 0x7d, 0x7e, 0x3f, 0x1b, 0x00}}},
+	PPU466::Tile{{{0xe0, 0xe0, 0xf0, 0xf8, 0xf8, 0xf8, 0xf0, 0x80}}, {{0x00, 0xd8, 0xfc, 0x7e, 0xbe, 0xbf, 0x1f, 0x1f}}},
+	PPU466::Tile{{{0x0f, 0x1f, 0x3f, 0x7f, 0xff, 0xff, 0xff, 0xff}}, {{0x00, 0x0d, 0x1e, 0x1f, 0x61, 0x7e, 0x7f, 0x7f}}},
+	PPU466::Tile{{{0xc0, 0xe0, 0xe0, 0xe0, 0xe0, 0xe0, 0xc0, 0x80}}, {{0x8f, 0xcf, 0xcf, 0xcf, 0xcf, 0xc6, 0x80, 0x00}}},
+	PPU466::Tile{{{0xff, 0xff, 0xff, 0xff, 0x7f, 0x7f, 0x3f, 0x1f}}, {{0x7e, 0x7d, 0x7b, 0x77, 0x2f, 0x1f, 0x1f, 0x00}}},
+	PPU466::Tile{{{0x01, 0x00, 0x00, 0x00, 0x00, 0x7c, 0xfe, 0xff}}, {{0xf8, 0xfc, 0xfc, 0xf8, 0x00, 0x7c, 0x82, 0x01}}},
+	PPU466::Tile{{{0x00, 0x00, 0x00, 0x1c, 0x3e, 0xfe, 0xfe, 0xff}}, {{0x07, 0x1f, 0x3f, 0x63, 0x41, 0xc2, 0x8e, 0x93}}},
+	PPU466::Tile{{{0xff, 0xff, 0xff, 0xff, 0xff, 0xfe, 0xfc, 0xf0}}, {{0x81, 0x41, 0x21, 0x11, 0x09, 0x06, 0x0c, 0xf0}}},
+	PPU466::Tile{{{0xff, 0xff, 0xff, 0xff, 0x7f, 0x3f, 0x1f, 0x0f}}, {{0xa4, 0xc8, 0x88, 0x88, 0x48, 0x30, 0x10, 0x0f}}},
+};
+
+} //namespace embedded_sprites_data
+
+constexpr SpriteBundle::Embedded embedded_sprites{
+	10, embedded_sprites_data::names, embedded_sprites_data::palettes, embedded_sprites_data::tiles
+};
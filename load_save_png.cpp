@@ -6,13 +6,30 @@
 #include <fstream>
 #include <cassert>
 #include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <unordered_map>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <stdlib.h> //for _fullpath
+#else
+#include <limits.h>
+#include <stdlib.h> //for realpath
+#endif
 
 #define LOG_ERROR( X ) std::cerr << X << std::endl
 
 using std::vector;
 
 bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vector< glm::u8vec4 > *data, OriginLocation origin);
+//returns false and sets *not_indexed if the image isn't palette-type:
+bool load_png_indexed(std::istream &from, IndexedPNG *image, OriginLocation origin, bool *not_indexed);
 void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8vec4 const *data, OriginLocation origin);
+void save_png_indexed(std::ostream &to, IndexedPNG const &image, OriginLocation origin);
 
 void load_png(std::string filename, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin) {
 	assert(size);
@@ -26,11 +43,181 @@ void load_png(std::string filename, glm::uvec2 *size, std::vector< glm::u8vec4 >
 	}
 }
 
+bool load_png_indexed(std::string filename, IndexedPNG *image, OriginLocation origin) {
+	assert(image);
+
+	std::ifstream file(filename.c_str(), std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Failed to open PNG image file '" + filename + "'.");
+	}
+	bool not_indexed = false;
+	if (!load_png_indexed(file, image, origin, &not_indexed)) {
+		if (not_indexed) return false;
+		throw std::runtime_error("Failed to read PNG image from '" + filename + "'.");
+	}
+	return true;
+}
+
 void save_png(std::string filename, glm::uvec2 size, glm::u8vec4 const *data, OriginLocation origin) {
 	std::ofstream file(filename.c_str(), std::ios::binary);
 	save_png(file, size.x, size.y, data, origin);
 }
 
+void save_png_indexed(std::string filename, IndexedPNG const &image, OriginLocation origin) {
+	if (image.palette.empty() || image.palette.size() > 256 || image.indices.size() != image.size.x * image.size.y) {
+		throw std::runtime_error("Can't save '" + filename + "': palette-type images need 1-256 palette entries and one index per pixel.");
+	}
+	std::ofstream file(filename.c_str(), std::ios::binary);
+	save_png_indexed(file, image, origin);
+}
+
+
+//------------------------------------------------
+//cache for load_png_cached:
+
+namespace {
+	struct PNGCacheEntry {
+		int64_t mtime = 0;
+		std::shared_ptr< PNGImage const > image;
+	};
+
+	struct PNGCache {
+		std::mutex mutex;
+		std::unordered_map< std::string, PNGCacheEntry > entries;
+		PNGCacheStats stats;
+	};
+
+	PNGCache &png_cache() {
+		static PNGCache cache;
+		return cache;
+	}
+
+	//resolve a path (so "a/../b.png" and "b.png" share an entry), and find its modification time:
+	// returns false if the file can't be found.
+	bool resolve(std::string const &filename, std::string *path, int64_t *mtime) {
+		#ifdef _WIN32
+		char buffer[_MAX_PATH];
+		if (!_fullpath(buffer, filename.c_str(), _MAX_PATH)) return false;
+		*path = buffer;
+		struct _stat64 info;
+		if (_stat64(path->c_str(), &info) != 0) return false;
+		*mtime = int64_t(info.st_mtime);
+		#else
+		char *resolved = realpath(filename.c_str(), nullptr);
+		if (!resolved) return false;
+		*path = resolved;
+		free(resolved);
+		struct stat info;
+		if (stat(path->c_str(), &info) != 0) return false;
+		#if defined(__APPLE__)
+		*mtime = int64_t(info.st_mtimespec.tv_sec) * 1000000000 + int64_t(info.st_mtimespec.tv_nsec);
+		#else
+		*mtime = int64_t(info.st_mtim.tv_sec) * 1000000000 + int64_t(info.st_mtim.tv_nsec);
+		#endif
+		#endif
+		return true;
+	}
+}
+
+std::shared_ptr< PNGImage const > load_png_cached(std::string const &filename, OriginLocation origin) {
+	std::string path;
+	int64_t mtime = 0;
+	if (!resolve(filename, &path, &mtime)) {
+		throw std::runtime_error("Failed to open PNG image file '" + filename + "'.");
+	}
+	std::string key = path + (origin == LowerLeftOrigin ? "|ll" : "|ul");
+
+	PNGCache &cache = png_cache();
+	{ //look for a current entry:
+		std::lock_guard< std::mutex > lock(cache.mutex);
+		auto f = cache.entries.find(key);
+		if (f != cache.entries.end() && f->second.mtime == mtime) {
+			cache.stats.hits += 1;
+			return f->second.image;
+		}
+		cache.stats.misses += 1;
+	}
+
+	//decode without holding the lock, so other threads can load other images meanwhile:
+	std::shared_ptr< PNGImage > image = std::make_shared< PNGImage >();
+	std::shared_ptr< IndexedPNG > indexed = std::make_shared< IndexedPNG >();
+	if (load_png_indexed(path, indexed.get(), origin)) {
+		image->size = indexed->size;
+		image->data.reserve(indexed->indices.size());
+		for (uint8_t i : indexed->indices) {
+			image->data.emplace_back(i < indexed->palette.size() ? indexed->palette[i] : glm::u8vec4(0x00, 0x00, 0x00, 0xff));
+		}
+		image->indexed = indexed;
+	} else {
+		load_png(path, &image->size, &image->data, origin);
+	}
+
+	std::lock_guard< std::mutex > lock(cache.mutex);
+	PNGCacheEntry &entry = cache.entries[key];
+	entry.mtime = mtime;
+	entry.image = image;
+	return image;
+}
+
+PNGBatch::PNGBatch(std::vector< std::string > const &filenames_, OriginLocation origin_) : filenames(filenames_), origin(origin_) {
+	promises.resize(filenames.size());
+	images.reserve(filenames.size());
+	for (auto &promise : promises) {
+		images.emplace_back(promise.get_future());
+	}
+
+	size_t count = std::min< size_t >(std::max(1U, std::thread::hardware_concurrency()), filenames.size());
+	workers.reserve(count);
+	try {
+		for (size_t w = 0; w < count; ++w) {
+			workers.emplace_back([this](){
+				while (true) {
+					size_t i = next.fetch_add(1);
+					if (i >= filenames.size()) break;
+					try {
+						promises[i].set_value(load_png_cached(filenames[i], origin));
+					} catch (...) {
+						promises[i].set_exception(std::current_exception());
+					}
+				}
+			});
+		}
+	} catch (...) {
+		//(couldn't start a thread; stop the ones that did start before unwinding)
+		next = filenames.size();
+		for (auto &worker : workers) worker.join();
+		throw;
+	}
+}
+
+PNGBatch::~PNGBatch() {
+	for (auto &worker : workers) {
+		worker.join();
+	}
+}
+
+std::unique_ptr< PNGBatch > load_png_batch(std::vector< std::string > const &filenames, OriginLocation origin) {
+	return std::unique_ptr< PNGBatch >(new PNGBatch(filenames, origin));
+}
+
+PNGCacheStats png_cache_stats() {
+	PNGCache &cache = png_cache();
+	std::lock_guard< std::mutex > lock(cache.mutex);
+	return cache.stats;
+}
+
+void png_cache_report(std::ostream &out) {
+	PNGCacheStats stats = png_cache_stats();
+	out << "png cache: " << stats.hits << " hits, " << stats.misses << " misses (decoded)" << std::endl;
+}
+
+void clear_png_cache() {
+	PNGCache &cache = png_cache();
+	std::lock_guard< std::mutex > lock(cache.mutex);
+	cache.entries.clear();
+}
+
+//------------------------------------------------
 
 static void user_read_data(png_structp png_ptr, png_bytep data, png_size_t length) {
 	std::istream *from = reinterpret_cast< std::istream * >(png_get_io_ptr(png_ptr));
@@ -127,6 +314,77 @@ bool load_png(std::istream &from, unsigned int *width, unsigned int *height, vec
 	return true;
 }
 
+bool load_png_indexed(std::istream &from, IndexedPNG *image, OriginLocation origin, bool *not_indexed) {
+	assert(image);
+	assert(not_indexed);
+	*image = IndexedPNG();
+	*not_indexed = false;
+
+	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, (png_voidp)NULL, (png_error_ptr)NULL, (png_error_ptr)NULL);
+	if (!png) {
+		LOG_ERROR("  cannot alloc read struct.");
+		return false;
+	}
+	png_set_read_fn(png, &from, user_read_data);
+
+	png_infop info = png_create_info_struct(png);
+	if (!info) {
+		LOG_ERROR("  cannot alloc info struct.");
+		png_destroy_read_struct(&png, (png_infopp)NULL, (png_infopp)NULL);
+		return false;
+	}
+	vector< png_bytep > row_pointers;
+	if (setjmp(png_jmpbuf(png))) {
+		LOG_ERROR("  png interal error.");
+		png_destroy_read_struct(&png, &info, (png_infopp)NULL);
+		*image = IndexedPNG();
+		return false;
+	}
+	png_read_info(png, info);
+	if (png_get_color_type(png, info) != PNG_COLOR_TYPE_PALETTE) {
+		png_destroy_read_struct(&png, &info, (png_infopp)NULL);
+		*not_indexed = true;
+		return false;
+	}
+	unsigned int w = png_get_image_width(png, info);
+	unsigned int h = png_get_image_height(png, info);
+
+	//palette, with transparency:
+	png_colorp colors = NULL;
+	int color_count = 0;
+	png_get_PLTE(png, info, &colors, &color_count);
+	png_bytep alphas = NULL;
+	int alpha_count = 0;
+	if (png_get_valid(png, info, PNG_INFO_tRNS)) {
+		png_get_tRNS(png, info, &alphas, &alpha_count, NULL);
+	}
+	image->palette.reserve(color_count);
+	for (int i = 0; i < color_count; ++i) {
+		image->palette.emplace_back(colors[i].red, colors[i].green, colors[i].blue, png_byte(i < alpha_count ? alphas[i] : 0xff));
+	}
+
+	//one byte per index:
+	if (png_get_bit_depth(png, info) < 8)
+		png_set_packing(png);
+	png_read_update_info(png, info);
+	assert(png_get_rowbytes(png, info) == w);
+
+	image->indices.resize(w*h);
+	row_pointers.resize(h);
+	for (unsigned int r = 0; r < h; ++r) {
+		if (origin == LowerLeftOrigin) {
+			row_pointers[h-1-r] = (png_bytep)(&image->indices[r*w]);
+		} else {
+			row_pointers[r] = (png_bytep)(&image->indices[r*w]);
+		}
+	}
+	if (h > 0) png_read_image(png, &row_pointers[0]);
+	png_destroy_read_struct(&png, &info, NULL);
+
+	image->size = glm::uvec2(w, h);
+	return true;
+}
+
 
 void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8vec4 const *data, OriginLocation origin) {
 //After the libpng example.c
@@ -173,3 +431,53 @@ void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8
 
 	return;
 }
+
+void save_png_indexed(std::ostream &to, IndexedPNG const &image, OriginLocation origin) {
+//Like save_png, but writes a PLTE (+ tRNS) chunk and 8-bit indices:
+	png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	if (png_ptr == NULL) {
+		LOG_ERROR("Can't create write struct.");
+		return;
+	}
+	png_set_write_fn(png_ptr, &to, user_write_data, user_flush_data);
+
+	png_infop info_ptr = png_create_info_struct(png_ptr);
+	if (info_ptr == NULL) {
+		png_destroy_write_struct(&png_ptr, NULL);
+		LOG_ERROR("Can't craete info pointer");
+		return;
+	}
+
+	//(filled in before setjmp, so nothing with a destructor is created after it)
+	vector< png_color > plte(image.palette.size());
+	vector< png_byte > trns(image.palette.size());
+	int trns_count = 0;
+	for (size_t i = 0; i < image.palette.size(); ++i) {
+		plte[i].red = image.palette[i].r;
+		plte[i].green = image.palette[i].g;
+		plte[i].blue = image.palette[i].b;
+		trns[i] = image.palette[i].a;
+		if (trns[i] != 0xff) trns_count = int(i) + 1; //tRNS only needs to reach the last entry that isn't opaque
+	}
+	vector< png_bytep > row_pointers(image.size.y);
+	for (unsigned int i = 0; i < image.size.y; ++i) {
+		unsigned int row = (origin == UpperLeftOrigin ? i : image.size.y - 1 - i);
+		row_pointers[i] = (png_bytep)&(image.indices[row * image.size.x]);
+	}
+
+	if (setjmp(png_jmpbuf(png_ptr))) {
+		png_destroy_write_struct(&png_ptr, &info_ptr);
+		LOG_ERROR("Error writing png.");
+		return;
+	}
+
+	png_set_IHDR(png_ptr, info_ptr, image.size.x, image.size.y, 8, PNG_COLOR_TYPE_PALETTE, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+	png_set_PLTE(png_ptr, info_ptr, plte.data(), int(plte.size()));
+	if (trns_count) png_set_tRNS(png_ptr, info_ptr, trns.data(), trns_count, NULL);
+
+	png_write_info(png_ptr, info_ptr);
+	png_write_image(png_ptr, row_pointers.data());
+	png_write_end(png_ptr, info_ptr);
+
+	png_destroy_write_struct(&png_ptr, &info_ptr);
+}
@@ -2,7 +2,12 @@
 
 #include <glm/glm.hpp>
 
+#include <atomic>
+#include <future>
+#include <iosfwd>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 #include <stdint.h>
 
@@ -18,3 +23,65 @@ enum OriginLocation {
 //NOTE: load_png will throw on error
 void load_png(std::string filename, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin);
 void save_png(std::string filename, glm::uvec2 size, glm::u8vec4 const *data, OriginLocation origin);
+
+
+//Indexed loading:
+// load_png_indexed reads a palette-type PNG without expanding it to RGBA,
+//  so callers that want palette indices anyway don't have to rediscover them from colors.
+struct IndexedPNG {
+	glm::uvec2 size = glm::uvec2(0);
+	std::vector< uint8_t > indices; //one per pixel (1-, 2-, and 4-bit images are unpacked)
+	std::vector< glm::u8vec4 > palette; //from PLTE, with alpha from tRNS (or 0xff where tRNS doesn't say)
+};
+//returns false (leaving *image empty) if the file isn't a palette-type PNG; throws on error, like load_png
+bool load_png_indexed(std::string filename, IndexedPNG *image, OriginLocation origin);
+//save_png_indexed writes one as a palette-type PNG (throws if the palette is empty or over 256 entries):
+void save_png_indexed(std::string filename, IndexedPNG const &image, OriginLocation origin);
+
+
+//Cached loading:
+// load_png_cached decodes each file once and hands out shared, immutable copies after that.
+// entries are keyed by resolved path (+ origin) and the file's modification time,
+//  so a file that changes on disk gets decoded again.
+// (safe to call from multiple threads; throws on error, like load_png)
+struct PNGImage {
+	glm::uvec2 size = glm::uvec2(0);
+	std::vector< glm::u8vec4 > data;
+	//palette-type files are read with load_png_indexed, and also keep their indices + palette here:
+	// (data is then just the palette looked up for each index)
+	std::shared_ptr< IndexedPNG const > indexed;
+};
+std::shared_ptr< PNGImage const > load_png_cached(std::string const &filename, OriginLocation origin);
+
+//Batch loading:
+// load_png_batch starts decoding many files at once (through load_png_cached, so results are cached)
+//  on worker threads owned by the returned batch, and returns immediately; images[i] becomes ready
+//  once filenames[i] is decoded.
+// (future::get() re-throws any error from loading that file)
+struct PNGBatch {
+	PNGBatch(std::vector< std::string > const &filenames, OriginLocation origin);
+	~PNGBatch(); //waits for the workers to finish (so any files not yet decoded still get decoded)
+	PNGBatch(PNGBatch const &) = delete;
+	PNGBatch &operator=(PNGBatch const &) = delete;
+
+	std::vector< std::future< std::shared_ptr< PNGImage const > > > images;
+
+private:
+	std::vector< std::string > filenames;
+	OriginLocation origin;
+	std::vector< std::promise< std::shared_ptr< PNGImage const > > > promises;
+	std::atomic< size_t > next{0}; //workers take the next file until none are left
+	std::vector< std::thread > workers;
+};
+std::unique_ptr< PNGBatch > load_png_batch(std::vector< std::string > const &filenames, OriginLocation origin);
+
+struct PNGCacheStats {
+	uint64_t hits = 0; //loads answered from the cache
+	uint64_t misses = 0; //loads that decoded the file
+};
+PNGCacheStats png_cache_stats();
+//print the stats on one line:
+void png_cache_report(std::ostream &out);
+
+//drop all cached images (images already handed out stay valid):
+void clear_png_cache();
@@ -10,9 +10,15 @@
 //GL.hpp will include a non-namespace-polluting set of opengl prototypes:
 #include "GL.hpp"
 
-//for screenshots:
+//for screenshots (and the png cache's stats):
 #include "load_save_png.hpp"
 
+//for per-phase frame timing:
+#include "FrameTimer.hpp"
+#ifdef TRACK_ALLOCATIONS
+#include "AllocationTracker.hpp"
+#endif
+
 //Includes for libSDL:
 #include <SDL.h>
 
@@ -112,12 +118,27 @@ int main(int argc, char **argv) {
 	};
 	on_resize();
 
+	//time each phase of every frame (press F1 for a report; one is also printed on exit):
+	FrameTimer frame_timer;
+
+	#ifdef TRACK_ALLOCATIONS
+	//the steady-state loop shouldn't touch the heap in update or draw:
+	set_allocation_budget(AllocationUpdate, 0);
+	set_allocation_budget(AllocationDraw, 0);
+	//(the first frame gets to allocate -- e.g., lazily-sized buffers -- so start counting after it)
+	bool first_frame = true;
+	#endif
+
 	//This will loop until the current mode is set to null:
 	while (Mode::current) {
 		//every pass through the game loop creates one frame of output
 		//  by performing three steps:
 
 		{ //(1) process any events that are pending
+			FrameTimer::Scope timing(frame_timer, FrameTimer::Events);
+			#ifdef TRACK_ALLOCATIONS
+			AllocationScope allocations(AllocationEvents);
+			#endif
 			static SDL_Event evt;
 			while (SDL_PollEvent(&evt) == 1) {
 				//handle resizing:
@@ -144,12 +165,19 @@ int main(int argc, char **argv) {
 						px.a = 0xff;
 					}
 					save_png(filename, glm::uvec2(w,h), data.data(), LowerLeftOrigin);
+				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_F1) {
+					// --- timing report key ---
+					frame_timer.report(std::cout);
+					png_cache_report(std::cout);
+					#ifdef TRACK_ALLOCATIONS
+					allocation_report(std::cout);
+					#endif
 				}
 			}
 			if (!Mode::current) break;
 		}
 
-		{ //(2) call the current mode's "update" function to deal with elapsed time:
+		{ //(2) call the current mode's "update" function in fixed steps to catch up with elapsed time:
 			auto current_time = std::chrono::high_resolution_clock::now();
 			static auto previous_time = current_time;
 			float elapsed = std::chrono::duration< float >(current_time - previous_time).count();
@@ -159,22 +187,53 @@ int main(int argc, char **argv) {
 			//lag to avoid spiral of death:
 			elapsed = std::min(0.1f, elapsed);
 
-			Mode::current->update(elapsed);
+			FrameTimer::Scope timing(frame_timer, FrameTimer::Update);
+			#ifdef TRACK_ALLOCATIONS
+			AllocationScope allocations(AllocationUpdate);
+			#endif
+			//time not yet simulated (always less than one step after the loop):
+			static float accumulated = 0.0f;
+			accumulated += elapsed;
+			const float step = 1.0f / Mode::update_rate;
+			while (accumulated >= step && Mode::current) {
+				Mode::current->update(step);
+				accumulated -= step;
+			}
 			if (!Mode::current) break;
+			Mode::current->update_alpha = accumulated / step;
 		}
 
 		{ //(3) call the current mode's "draw" function to produce output:
-		
+			FrameTimer::Scope timing(frame_timer, FrameTimer::Draw);
+			#ifdef TRACK_ALLOCATIONS
+			AllocationScope allocations(AllocationDraw);
+			#endif
+			frame_timer.gpu_begin();
 			Mode::current->draw(drawable_size);
+			frame_timer.gpu_end();
 		}
 
-		//Wait until the recently-drawn frame is shown before doing it all again:
-		SDL_GL_SwapWindow(window);
+		#ifdef TRACK_ALLOCATIONS
+		allocation_end_frame(!first_frame);
+		first_frame = false;
+		#endif
+
+		{ //Wait until the recently-drawn frame is shown before doing it all again:
+			FrameTimer::Scope timing(frame_timer, FrameTimer::Swap);
+			SDL_GL_SwapWindow(window);
+		}
 	}
 
 
 	//------------  teardown ------------
 
+	frame_timer.report(std::cout);
+	png_cache_report(std::cout);
+	#ifdef TRACK_ALLOCATIONS
+	allocation_report(std::cout);
+	#endif
+	frame_timer.release_gl();
+
 	SDL_GL_DeleteContext(context);
 	context = 0;
 
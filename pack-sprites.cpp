@@ -0,0 +1,93 @@
+//pack-sprites -- convert PNG sprites into a SpriteBundle the game can load without decoding any images.
+//
+// usage: pack-sprites <out.sprites> <in.png> [in.png ...]
+//
+// each input is either:
+//  - a sprite sheet: a PNG of 16x16 sprites with a names file next to it (see TileSheet.hpp);
+//     e.g., 'sheet.png' + 'sheet.txt'
+//  - or a single 16x16 sprite, named after its image file without directories or extension
+//     (e.g., 'images/shrimp_top.png' becomes 'shrimp_top').
+//
+// if the output ends in '.hpp', writes a header of constexpr tables instead (see SpriteBundle::save_header),
+//  defining a SpriteBundle::Embedded named after the output file (e.g., 'embedded_sprites.hpp' defines 'embedded_sprites').
+//
+// to rebuild the game's bundle (from the game directory):
+//  dist/pack-sprites dist/shrimp.sprites images/*.png
+// ...and the header used by builds with EMBED_SPRITES defined:
+//  dist/pack-sprites embedded_sprites.hpp images/*.png
+
+#include "SpriteBundle.hpp"
+#include "TileSheet.hpp"
+#include "load_save_png.hpp"
+
+#include <cctype>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+int main(int argc, char **argv) {
+	if (argc < 3) {
+		std::cerr << "usage:\n\t" << argv[0] << " <out.sprites|out.hpp> <in.png|sheet.png> [...]" << std::endl;
+		return 1;
+	}
+
+	//name is the file name without directories or extension:
+	auto name_of = [](std::string const &filename) {
+		std::string name = filename;
+		auto slash = name.find_last_of("/\\");
+		if (slash != std::string::npos) name = name.substr(slash + 1);
+		auto dot = name.rfind('.');
+		if (dot != std::string::npos) name = name.substr(0, dot);
+		return name;
+	};
+
+	try {
+		SpriteBundle bundle;
+		auto add = [&bundle](std::string const &name, SpriteBundle::Sprite const &sprite) {
+			if (bundle.sprites.count(name)) {
+				throw std::runtime_error("More than one sprite named '" + name + "'.");
+			}
+			bundle.sprites[name] = sprite;
+		};
+		//decode every input at once, then encode them in order as each one is ready:
+		std::vector< std::string > filenames(argv + 2, argv + argc);
+		std::unique_ptr< PNGBatch > batch = load_png_batch(filenames, LowerLeftOrigin);
+		for (size_t i = 0; i < filenames.size(); ++i) {
+			std::string const &filename = filenames[i];
+			std::shared_ptr< PNGImage const > image;
+			try {
+				image = batch->images[i].get();
+			} catch (std::exception const &e) {
+				throw std::runtime_error("'" + filename + "': " + e.what());
+			}
+			if (is_sprite_sheet(filename)) {
+				//(the batch already put the sheet in the png cache, so this just reads the names)
+				for (auto const &named : load_sprite_sheet(filename)) {
+					add(named.first, named.second);
+				}
+			} else {
+				add(name_of(filename), SpriteBundle::encode(*image));
+			}
+		}
+
+		std::string out = argv[1];
+		if (out.size() > 4 && out.substr(out.size() - 4) == ".hpp") {
+			//symbol is the output's name, with anything that can't go in an identifier replaced:
+			std::string symbol = name_of(out);
+			for (char &c : symbol) {
+				if (!(isalnum(uint8_t(c)) || c == '_')) c = '_';
+			}
+			if (symbol.empty() || isdigit(uint8_t(symbol[0]))) symbol = "_" + symbol;
+			bundle.save_header(out, symbol);
+		} else {
+			bundle.save(out);
+		}
+		std::cout << "Wrote " << bundle.sprites.size() << " sprites to '" << argv[1] << "'." << std::endl;
+		png_cache_report(std::cout);
+	} catch (std::exception const &e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,945 @@
+//ppu-bench -- time the CPU-side work of a PPU466 frame without a window or GL context.
+//
+// usage: ppu-bench [--scene empty|shrimp|churn|all] [--frames N] [--kernels portable|sse2|avx2] [--raster]
+//        ppu-bench --verify
+//
+// For each scene, runs N frames of the CPU work PPU466::draw does:
+//  build  - PPU466::build (snapshotting PPU state and expanding changed tiles)
+//  pack   - the copy submit() makes of the frame's palettes, background, and sprites into the stream buffer
+// ...and (with --raster) PPU466::render_to_buffer, the CPU rasterizer.
+//
+// Reports ns/frame for each stage and heap allocations/frame (counted by AllocationTracker, as the draw phase).
+//
+// With --verify, instead checks the SIMD kernels (bitplanes, box_overlap), CollisionGrid, and the CPU rasterizer against plain scalar code,
+//  and that sprites encode the same from RGBA and palette-type PNGs (see verify(), below)
+//  and exits with status 1 if anything differs.
+
+#include "PPU466.hpp"
+#include "bitplanes.hpp"
+#include "TileSheet.hpp"
+#include "SpriteBundle.hpp"
+#include "box_overlap.hpp"
+#include "CollisionGrid.hpp"
+#include "load_save_png.hpp"
+#include "AllocationTracker.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+//---------------------------------------------
+//the CPU work of PPU466::draw:
+
+//stand-in for one region of the PPU's stream buffer:
+struct StreamRegion {
+	decltype(PPU466::palette_table) palette_table;
+	decltype(PPU466::background) background;
+	decltype(PPU466::sprites) sprites;
+};
+
+struct Stages {
+	PPU466::FrameData frame;
+	StreamRegion region;
+	std::vector< glm::u8vec4 > raster;
+
+	//results are folded into this so the compiler can't skip any work:
+	uint64_t checksum = 0;
+
+	void build(PPU466 const &ppu) {
+		ppu.build(frame);
+		checksum += frame.tile_texture[checksum % frame.tile_texture.size()] + uint64_t(frame.background_position.x);
+	}
+
+	void pack() {
+		std::memcpy(static_cast< void * >(&region.palette_table), static_cast< void const * >(&frame.palette_table), sizeof(frame.palette_table));
+		std::memcpy(&region.background, &frame.background, sizeof(frame.background));
+		std::memcpy(&region.sprites, &frame.sprites, sizeof(frame.sprites));
+		checksum += region.background[checksum % region.background.size()];
+	}
+
+	void rasterize(PPU466 const &ppu) {
+		ppu.render_to_buffer(&raster);
+		checksum += raster[checksum % raster.size()].r;
+	}
+};
+
+//---------------------------------------------
+//scenes:
+
+struct Scene {
+	virtual ~Scene() { }
+	//set up the PPU before the first frame:
+	virtual void setup(PPU466 &ppu) { }
+	//change the PPU the way a game would before drawing frame 'frame':
+	virtual void update(PPU466 &ppu, uint32_t frame) { }
+};
+
+//nothing changes: PPU466's default state, drawn over and over:
+struct EmptyScene : Scene {
+};
+
+//like ShrimpMode: a dozen static 16x16 objects, four (mostly hidden) player sprites, blank background:
+struct ShrimpScene : Scene {
+	virtual void setup(PPU466 &ppu) override {
+		std::mt19937 mt(0x15466);
+		for (auto &palette : ppu.palette_table) {
+			palette[0] = glm::u8vec4(0x00);
+			for (uint32_t c = 1; c < 4; ++c) {
+				palette[c] = glm::u8vec4(mt() & 0xff, mt() & 0xff, mt() & 0xff, 0xff);
+			}
+		}
+		for (auto &tile : ppu.tile_table) {
+			for (uint32_t row = 0; row < 8; ++row) {
+				tile.bit0[row] = uint8_t(mt());
+				tile.bit1[row] = uint8_t(mt());
+			}
+		}
+		ppu.tile_table[255] = PPU466::Tile{};
+		ppu.mark_all_tiles_dirty();
+		for (auto &info : ppu.background) {
+			info = 255;
+		}
+		for (uint32_t i = 0; i < ppu.sprites.size(); ++i) {
+			PPU466::Sprite &sprite = ppu.sprites[i];
+			if (i < Objects) {
+				sprite.x = uint8_t(mt() % (PPU466::ScreenWidth - 16));
+				sprite.y = uint8_t(mt() % (PPU466::ScreenHeight - 16));
+				sprite.index = uint8_t((i % 8) * 2 + (i / 8) * 32); //2x2 tile blocks
+				sprite.attributes = uint8_t(0x40 | (1 + i % 7));
+			} else {
+				sprite.y = 240; //offscreen
+			}
+		}
+	}
+	virtual void update(PPU466 &ppu, uint32_t frame) override {
+		//objects get eaten and come back:
+		for (uint32_t i = 0; i < Objects - 4; ++i) {
+			bool consumed = ((frame / 60 + i) % 5) == 0;
+			ppu.sprites[i].attributes = uint8_t(0x40 | (consumed ? 0 : 1 + i % 7));
+		}
+		//player wanders around as one of four shades:
+		uint32_t shade = (frame / 120) % 4;
+		for (uint32_t s = 0; s < 4; ++s) {
+			PPU466::Sprite &sprite = ppu.sprites[Objects - 4 + s];
+			sprite.x = uint8_t(frame % (PPU466::ScreenWidth - 16));
+			sprite.y = uint8_t((frame / 2) % (PPU466::ScreenHeight - 16));
+			sprite.attributes = uint8_t(0x40 | (s == shade ? 1 + s : 0));
+		}
+	}
+	enum : uint32_t { Objects = 16 };
+};
+
+//like PlayMode::draw: background and every sprite rewritten each frame, background scrolling,
+// plus the whole tile table changing every frame (the worst case for tile expansion):
+struct ChurnScene : Scene {
+	virtual void update(PPU466 &ppu, uint32_t frame) override {
+		float fade = frame / 600.0f;
+		ppu.background_color = glm::u8vec3(frame & 0xff, (frame * 3) & 0xff, (frame * 7) & 0xff);
+		for (uint32_t y = 0; y < PPU466::BackgroundHeight; ++y) {
+			for (uint32_t x = 0; x < PPU466::BackgroundWidth; ++x) {
+				ppu.background[x+PPU466::BackgroundWidth*y] = uint16_t((x+y+frame)%16);
+			}
+		}
+		ppu.background_position.x = -int32_t(frame);
+		ppu.background_position.y = -int32_t(frame / 2);
+		for (uint32_t i = 0; i < 63; ++i) {
+			float amt = (i + 2.0f * fade) / 62.0f;
+			ppu.sprites[i].x = uint8_t(int32_t(0.5f * PPU466::ScreenWidth + std::cos(6.2831853f * amt * 5.0f) * 0.4f * PPU466::ScreenWidth));
+			ppu.sprites[i].y = uint8_t(int32_t(0.5f * PPU466::ScreenHeight + std::sin(6.2831853f * amt * 3.0f) * 0.4f * PPU466::ScreenWidth));
+			ppu.sprites[i].index = 32;
+			ppu.sprites[i].attributes = uint8_t(6 | (i % 2 ? 0x80 : 0x00));
+		}
+		for (uint32_t t = 0; t < ppu.tile_table.size(); ++t) {
+			PPU466::Tile &tile = ppu.tile_table[t];
+			for (uint32_t row = 0; row < 8; ++row) {
+				tile.bit0[row] = uint8_t(tile.bit0[row] + 1);
+				tile.bit1[row] = uint8_t(tile.bit1[row] ^ (row + frame));
+			}
+		}
+		ppu.mark_all_tiles_dirty();
+	}
+};
+
+//---------------------------------------------
+//--verify: check each set of kernels this CPU supports against plain scalar loops
+// (the loops PPU466::draw and set_tilebits ran before there were kernels).
+
+//counts mismatches, printing the first few:
+struct Mismatches {
+	Mismatches(std::string const &check_) : check(check_) { }
+	std::string check;
+	uint32_t count = 0;
+	void add(std::string const &what) {
+		if (count < 8) std::cout << "  MISMATCH in " << check << ": " << what << "\n";
+		count += 1;
+	}
+};
+
+static uint32_t verify_bitplanes(BitplanesKernels kernels) {
+	Mismatches mismatches(std::string(bitplanes_kernels_name(kernels)) + " bitplanes kernels");
+
+	//expand -- every possible (bit0, bit1) row, eight rows per tile,
+	// written with a stride wider than a tile to check nothing outside the tile is touched:
+	const uint32_t Stride = 13;
+	for (uint32_t row = 0; row < 0x10000; row += 8) {
+		PPU466::Tile tile;
+		for (uint32_t y = 0; y < 8; ++y) {
+			tile.bit0[y] = uint8_t((row + y) & 0xff);
+			tile.bit1[y] = uint8_t((row + y) >> 8);
+		}
+		std::array< uint8_t, Stride * 8 > indices;
+		indices.fill(0xee);
+		bitplanes_expand_tile(tile, indices.data(), Stride);
+		for (uint32_t y = 0; y < 8; ++y) {
+			for (uint32_t x = 0; x < Stride; ++x) {
+				uint8_t expected = 0xee;
+				if (x < 8) {
+					expected = uint8_t(
+						  ((tile.bit0[y] >> x) & 1)
+						| ((tile.bit1[y] >> x) & 1) << 1);
+				}
+				if (indices[y * Stride + x] != expected) {
+					mismatches.add("expand of bit0 " + std::to_string(tile.bit0[y]) + ", bit1 " + std::to_string(tile.bit1[y])
+						+ " gave " + std::to_string(indices[y * Stride + x]) + " at x " + std::to_string(x));
+				}
+			}
+		}
+	}
+
+	//pack -- every possible row of eight 2-bit indices (with junk in the high bits, which should be ignored):
+	for (uint32_t row = 0; row < 0x10000; row += 8) {
+		std::array< uint8_t, Stride * 8 > indices;
+		for (uint32_t y = 0; y < 8; ++y) {
+			for (uint32_t x = 0; x < Stride; ++x) {
+				indices[y * Stride + x] = uint8_t(((((row + y) >> (2 * x)) & 3) | ((x * 37 + y * 11) & 0xfc)));
+			}
+		}
+		PPU466::Tile tile = bitplanes_pack_tile(indices.data(), Stride);
+		for (uint32_t y = 0; y < 8; ++y) {
+			uint8_t bit0 = 0, bit1 = 0;
+			for (uint32_t x = 0; x < 8; ++x) {
+				uint8_t index = indices[y * Stride + x];
+				bit0 |= uint8_t((index & 1) << x);
+				bit1 |= uint8_t(((index >> 1) & 1) << x);
+			}
+			if (tile.bit0[y] != bit0 || tile.bit1[y] != bit1) {
+				mismatches.add("pack of row " + std::to_string(row + y));
+			}
+		}
+	}
+
+	//colors to indices -- every pattern of equal entries a palette can have (4^4 ways to fill it from four colors),
+	// against runs of colors that match one or more entries, differ from one by a single bit, or match nothing;
+	// every run length up to 67, so each kernel's main loop and leftover handling are both covered:
+	std::array< glm::u8vec4, 4 > bases = {
+		glm::u8vec4(0x00, 0x00, 0x00, 0x00), glm::u8vec4(0xff, 0x80, 0x01, 0xff),
+		glm::u8vec4(0x12, 0x34, 0x56, 0x78), glm::u8vec4(0x80, 0x80, 0x80, 0x80),
+	};
+	std::vector< glm::u8vec4 > pool(bases.begin(), bases.end());
+	for (glm::u8vec4 const &base : bases) {
+		for (uint32_t c = 0; c < 4; ++c) {
+			for (uint8_t flip : { uint8_t(0x01), uint8_t(0x80) }) {
+				glm::u8vec4 near = base;
+				near[c] ^= flip;
+				pool.emplace_back(near);
+			}
+		}
+	}
+	pool.emplace_back(0xff, 0xff, 0xff, 0xff);
+	std::mt19937 mt(0x15466);
+	std::vector< glm::u8vec4 > colors(67);
+	for (auto &color : colors) color = pool[mt() % pool.size()];
+
+	for (uint32_t fill = 0; fill < 256; ++fill) {
+		PPU466::Palette palette;
+		for (uint32_t p = 0; p < 4; ++p) {
+			palette[p] = bases[(fill >> (2 * p)) & 3];
+		}
+		for (uint32_t count = 0; count <= colors.size(); ++count) {
+			std::vector< uint8_t > indices(colors.size() + 1, 0xee);
+			bitplanes_colors_to_indices(colors.data(), count, palette, indices.data());
+			for (uint32_t i = 0; i < indices.size(); ++i) {
+				uint8_t expected = 0xee;
+				if (i < count) {
+					expected = 0;
+					for (uint8_t p = 0; p < 4; ++p) {
+						if (colors[i] == palette[p]) expected |= p;
+					}
+				}
+				if (indices[i] != expected) {
+					mismatches.add("color " + std::to_string(i) + " of " + std::to_string(count)
+						+ " with palette fill " + std::to_string(fill));
+				}
+			}
+		}
+	}
+
+	return mismatches.count;
+}
+
+//box_overlap_16x16 against testing each box in turn:
+// (every count up to 200 so all leftover lengths are covered; coordinates include the ends of the int16_t range,
+//  and queries include ones that just touch boxes, have fractional corners, are empty, or reach far outside int16_t)
+static uint32_t verify_box_overlap(BitplanesKernels kernels) {
+	Mismatches mismatches(std::string(bitplanes_kernels_name(kernels)) + " box_overlap_16x16");
+	std::mt19937 mt(0x15466);
+	auto coordinate = [&mt]() -> int16_t {
+		switch (mt() % 8) {
+			case 0: return int16_t(-32768);
+			case 1: return int16_t(32767);
+			case 2: return int16_t(mt());
+			default: return int16_t(int32_t(mt() % 96) - 16);
+		}
+	};
+	auto bound = [&mt]() -> float {
+		switch (mt() % 8) {
+			case 0: return -1e6f;
+			case 1: return 1e6f;
+			case 2: return float(int32_t(mt() % 96) - 16) + 0.5f;
+			default: return float(int32_t(mt() % 96) - 16);
+		}
+	};
+
+	std::vector< int16_t > xs, ys;
+	std::vector< uint64_t > hits, expected;
+	for (uint32_t trial = 0; trial < 20; ++trial) {
+		for (uint32_t count = 0; count <= 200; ++count) {
+			xs.resize(count);
+			ys.resize(count);
+			for (uint32_t i = 0; i < count; ++i) {
+				xs[i] = coordinate();
+				ys[i] = coordinate();
+			}
+			glm::vec2 min(bound(), bound());
+			glm::vec2 max = (mt() % 4 == 0 ? glm::vec2(bound(), bound()) : min + glm::vec2(float(mt() % 20), float(mt() % 20)));
+
+			expected.assign((count + 63) / 64, 0);
+			uint32_t expected_total = 0;
+			for (uint32_t i = 0; i < count; ++i) {
+				//(in double, so x + 16 is exact even at the ends of the range)
+				double x = xs[i], y = ys[i];
+				if (x <= max.x && x + 16.0 >= min.x && y <= max.y && y + 16.0 >= min.y) {
+					expected[i / 64] |= uint64_t(1) << (i % 64);
+					expected_total += 1;
+				}
+			}
+			hits.assign((count + 63) / 64, ~uint64_t(0)); //(every word should be overwritten)
+			uint32_t total = box_overlap_16x16(xs.data(), ys.data(), count, min, max, hits.data());
+			if (hits != expected || total != expected_total) {
+				mismatches.add(std::to_string(count) + " boxes, query (" + std::to_string(min.x) + ", " + std::to_string(min.y)
+					+ ") - (" + std::to_string(max.x) + ", " + std::to_string(max.y) + "): " + std::to_string(total)
+					+ " hits (expected " + std::to_string(expected_total) + ")");
+			}
+		}
+	}
+	return mismatches.count;
+}
+
+//CollisionGrid queries against testing every box, as objects come and go:
+// (boxes include ones that start or end exactly on cell edges, ones with fractional corners,
+//  and ones partly or entirely off the edge of the grid)
+static uint32_t verify_collision_grid() {
+	Mismatches mismatches("CollisionGrid");
+	std::mt19937 mt(0x15466);
+	auto coordinate = [&mt]() {
+		float v = float(int32_t(mt() % 320) - 32);
+		if (mt() % 2) v = std::floor(v / 16.0f) * 16.0f; //on a cell edge
+		if (mt() % 4 == 0) v += 0.5f;
+		return v;
+	};
+	auto random_box = [&]() {
+		CollisionGrid::Box box;
+		box.min = glm::vec2(coordinate(), coordinate());
+		box.max = box.min + (mt() % 2 ? glm::vec2(16.0f) : glm::vec2(float(mt() % 40), float(mt() % 40)));
+		return box;
+	};
+	auto overlaps = [](CollisionGrid::Box const &a, CollisionGrid::Box const &b) {
+		return !(a.min.x > b.max.x || a.max.x < b.min.x || a.min.y > b.max.y || a.max.y < b.min.y);
+	};
+
+	const uint32_t Objects = 500;
+	CollisionGrid grid(glm::uvec2(PPU466::ScreenWidth, PPU466::ScreenHeight));
+	std::vector< CollisionGrid::Box > boxes(Objects);
+	std::vector< bool > in_grid(Objects, false);
+	std::vector< uint32_t > got, expected;
+	for (uint32_t step = 0; step < 20000; ++step) {
+		//add or remove an object:
+		uint32_t id = mt() % Objects;
+		if (in_grid[id]) {
+			grid.remove(id);
+			in_grid[id] = false;
+		} else {
+			boxes[id] = random_box();
+			grid.insert(id, boxes[id]);
+			in_grid[id] = true;
+		}
+		if (grid.contains(id) != in_grid[id]) {
+			mismatches.add("contains(" + std::to_string(id) + ") at step " + std::to_string(step));
+		}
+
+		//...and query:
+		CollisionGrid::Box query = random_box();
+		got.clear();
+		grid.query(query, [&got](uint32_t i) { got.emplace_back(i); });
+		std::sort(got.begin(), got.end());
+		expected.clear();
+		for (uint32_t i = 0; i < Objects; ++i) {
+			if (in_grid[i] && overlaps(boxes[i], query)) expected.emplace_back(i);
+		}
+		if (got != expected) {
+			mismatches.add("query at step " + std::to_string(step) + " found " + std::to_string(got.size())
+				+ " objects (expected " + std::to_string(expected.size()) + ")");
+		}
+	}
+	return mismatches.count;
+}
+
+//render_to_buffer against working out each pixel on its own, straight from the PPU466 docs:
+// (clear to the background color, then 'behind' sprites, the background, and 'in front' sprites,
+//  each drawn over what's there with the same blend draw() uses)
+
+static glm::u8vec4 reference_pixel(PPU466 const &ppu, int32_t x, int32_t y) {
+	uint32_t color[3] = { ppu.background_color.r, ppu.background_color.g, ppu.background_color.b };
+	auto over = [&color](glm::u8vec4 const &src) {
+		uint32_t from[3] = { src.r, src.g, src.b };
+		for (uint32_t c = 0; c < 3; ++c) {
+			color[c] = (from[c] * src.a + color[c] * (255 - src.a) + 127) / 255;
+		}
+	};
+	auto index_at = [](PPU466::Tile const &tile, int32_t tx, int32_t ty) {
+		return ((tile.bit0[ty] >> tx) & 1) | (((tile.bit1[ty] >> tx) & 1) << 1);
+	};
+	auto draw_sprites = [&](uint8_t priority) {
+		for (auto const &sprite : ppu.sprites) {
+			if ((sprite.attributes & 0x80) != priority) continue;
+			int32_t size = (sprite.attributes & 0x40) ? 16 : 8;
+			int32_t sx = x - int32_t(sprite.x);
+			int32_t sy = y - int32_t(sprite.y);
+			if (sx < 0 || sx >= size || sy < 0 || sy >= size) continue;
+			PPU466::Tile const &tile = ppu.tile_table[uint8_t(sprite.index + sx / 8 + (sy / 8) * 16)];
+			over(ppu.palette_table[sprite.attributes & 0x07][index_at(tile, sx % 8, sy % 8)]);
+		}
+	};
+
+	draw_sprites(0x80);
+
+	const int32_t Width = int32_t(PPU466::BackgroundWidth) * 8;
+	const int32_t Height = int32_t(PPU466::BackgroundHeight) * 8;
+	int32_t bx = ((x - ppu.background_position.x) % Width + Width) % Width;
+	int32_t by = ((y - ppu.background_position.y) % Height + Height) % Height;
+	uint16_t info = ppu.background[(by / 8) * PPU466::BackgroundWidth + bx / 8];
+	over(ppu.palette_table[(info >> 8) & 0x07][index_at(ppu.tile_table[info & 0xff], bx % 8, by % 8)]);
+
+	draw_sprites(0x00);
+
+	return glm::u8vec4(color[0], color[1], color[2], 0xff);
+}
+
+//every PPU feature at once, re-randomized each frame: 8x8 and 16x16 sprites of both priorities anywhere
+// (including hanging off the right and top edges, and metasprites whose tiles wrap past 255),
+// palettes with partly transparent colors (so drawing has to blend), and far-off background positions:
+struct MixScene : Scene {
+	virtual void update(PPU466 &ppu, uint32_t frame) override {
+		std::mt19937 mt(frame);
+		ppu.background_color = glm::u8vec3(mt() & 0xff, mt() & 0xff, mt() & 0xff);
+		for (uint32_t p = 0; p < ppu.palette_table.size(); ++p) {
+			for (auto &color : ppu.palette_table[p]) {
+				uint8_t alpha = 0xff;
+				if (p % 2) {
+					switch (mt() % 3) {
+						case 0: alpha = 0x00; break;
+						case 1: alpha = 0xff; break;
+						default: alpha = uint8_t(mt()); break;
+					}
+				} else if (mt() % 4 == 0) {
+					alpha = 0x00; //(even palettes stay 'simple': every color fully transparent or opaque)
+				}
+				color = glm::u8vec4(mt() & 0xff, mt() & 0xff, mt() & 0xff, alpha);
+			}
+		}
+		for (auto &tile : ppu.tile_table) {
+			for (uint32_t row = 0; row < 8; ++row) {
+				//(some rows blank, since drawing skips rows that are all color 0)
+				tile.bit0[row] = (mt() % 4 ? uint8_t(mt()) : 0);
+				tile.bit1[row] = (mt() % 4 ? uint8_t(mt()) : 0);
+			}
+		}
+		ppu.mark_all_tiles_dirty();
+		for (auto &info : ppu.background) {
+			info = uint16_t(mt() & 0x7ff);
+		}
+		ppu.background_position = glm::ivec2(int32_t(mt() % 200000) - 100000, int32_t(mt() % 200000) - 100000);
+		for (auto &sprite : ppu.sprites) {
+			sprite.x = uint8_t(mt());
+			sprite.y = uint8_t(mt());
+			sprite.index = uint8_t(mt());
+			sprite.attributes = uint8_t(mt() & 0xc7);
+		}
+	}
+};
+
+static uint32_t verify_render() {
+	Mismatches mismatches("render_to_buffer");
+	EmptyScene empty;
+	ShrimpScene shrimp;
+	ChurnScene churn;
+	MixScene mix;
+	std::vector< std::pair< char const *, Scene * > > scenes = {
+		{"empty", &empty}, {"shrimp", &shrimp}, {"churn", &churn}, {"mix", &mix}
+	};
+	auto rgb = [](glm::u8vec4 const &c) {
+		return "(" + std::to_string(c.r) + ", " + std::to_string(c.g) + ", " + std::to_string(c.b) + ", " + std::to_string(c.a) + ")";
+	};
+	std::vector< glm::u8vec4 > image;
+	for (auto const &named : scenes) {
+		PPU466 ppu;
+		named.second->setup(ppu);
+		//(scenes change on their own schedules, so check a spread of frames)
+		for (uint32_t frame = 0; frame < 1200; frame += 61) {
+			named.second->update(ppu, frame);
+			ppu.render_to_buffer(&image);
+			uint32_t wrong = 0;
+			std::string first;
+			for (int32_t y = 0; y < int32_t(PPU466::ScreenHeight); ++y) {
+				for (int32_t x = 0; x < int32_t(PPU466::ScreenWidth); ++x) {
+					glm::u8vec4 expected = reference_pixel(ppu, x, y);
+					glm::u8vec4 got = image[y * PPU466::ScreenWidth + x];
+					if (got == expected) continue;
+					if (wrong == 0) {
+						first = "(" + std::to_string(x) + ", " + std::to_string(y) + ") is " + rgb(got) + ", expected " + rgb(expected);
+					}
+					wrong += 1;
+				}
+			}
+			if (wrong) {
+				mismatches.add(std::string(named.first) + " scene, frame " + std::to_string(frame) + ": "
+					+ std::to_string(wrong) + " pixels differ; first " + first);
+			}
+		}
+	}
+	return mismatches.count;
+}
+
+//SpriteBundle::encode of RGBA art against SpriteBundle::encode_indexed of the same art as palette-type data,
+// both in memory and saved to (then loaded back from) RGBA and palette-type PNGs; also checks that each
+// sprite draws its art exactly. art includes transparent pixels with nonzero color channels, partly
+// transparent colors, palettes with duplicate and unused entries, and too many colors (the extras are dropped):
+// (writes the PNGs to the current directory, and removes them afterward)
+static uint32_t verify_sprite_encoding() {
+	Mismatches mismatches("sprite encoding");
+	std::mt19937 mt(0x15466);
+	auto same = [](SpriteBundle::Sprite const &a, SpriteBundle::Sprite const &b) {
+		return a.palette == b.palette && std::memcmp(a.tiles.data(), b.tiles.data(), sizeof(a.tiles)) == 0;
+	};
+	auto random_color = [&mt](uint8_t alpha) {
+		return glm::u8vec4(uint8_t(mt()), uint8_t(mt()), uint8_t(mt()), alpha);
+	};
+	const std::string rgba_file = "ppu-bench-rgba.png";
+	const std::string indexed_file = "ppu-bench-indexed.png";
+
+	for (uint32_t trial = 0; trial < 400; ++trial) {
+		//palette-type art: a shuffled palette with a few transparent entries, 'colors' visible colors
+		// (one perhaps listed twice), and entries no pixel uses:
+		uint32_t colors = trial % 6; //(4 and 5 are too many)
+		IndexedPNG indexed;
+		indexed.size = glm::uvec2(16, 16);
+		indexed.palette.emplace_back(glm::u8vec4(0x00));
+		indexed.palette.emplace_back(random_color(0x00));
+		for (uint32_t c = 0; c < colors; ++c) {
+			indexed.palette.emplace_back(random_color(uint8_t(mt() % 3 ? 0xff : 1 + mt() % 254)));
+		}
+		if (colors && mt() % 2) indexed.palette.emplace_back(indexed.palette.back());
+		uint32_t used = uint32_t(indexed.palette.size());
+		for (uint32_t extra = mt() % 3; extra > 0; --extra) {
+			indexed.palette.emplace_back(random_color(0xff));
+		}
+		std::vector< uint8_t > order(indexed.palette.size());
+		for (uint32_t i = 0; i < order.size(); ++i) order[i] = uint8_t(i);
+		std::shuffle(order.begin(), order.end(), mt);
+		std::vector< glm::u8vec4 > shuffled(indexed.palette.size());
+		for (uint32_t i = 0; i < order.size(); ++i) shuffled[order[i]] = indexed.palette[i];
+		indexed.palette = shuffled;
+		indexed.indices.resize(16 * 16);
+		for (auto &index : indexed.indices) {
+			index = order[mt() % used];
+		}
+		//(make sure every visible color shows up at least once)
+		for (uint32_t c = 0; c < used; ++c) {
+			indexed.indices[mt() % indexed.indices.size()] = order[c];
+		}
+
+		//...and the same art as RGBA:
+		std::vector< glm::u8vec4 > data(indexed.indices.size());
+		for (uint32_t i = 0; i < data.size(); ++i) {
+			data[i] = indexed.palette[indexed.indices[i]];
+		}
+
+		SpriteBundle::Sprite from_rgba, from_indexed;
+		try {
+			from_rgba = SpriteBundle::encode(indexed.size, data);
+			from_indexed = SpriteBundle::encode_indexed(indexed);
+		} catch (std::exception const &e) {
+			mismatches.add("art " + std::to_string(trial) + ": " + e.what());
+			continue;
+		}
+		if (!same(from_rgba, from_indexed)) {
+			mismatches.add("art " + std::to_string(trial) + ": encode and encode_indexed disagree");
+		}
+
+		//the sprite should draw the art: the first three visible colors (in pixel order) as themselves,
+		// everything else as index 0:
+		std::vector< glm::u8vec4 > kept;
+		for (auto const &color : data) {
+			if (color.a != 0 && kept.size() < 3 && std::find(kept.begin(), kept.end(), color) == kept.end()) kept.emplace_back(color);
+		}
+		for (uint32_t i = 0; i < data.size(); ++i) {
+			uint32_t x = i % 16, y = i / 16;
+			PPU466::Tile const &tile = from_rgba.tiles[(x / 8) + 2 * (y / 8)];
+			uint32_t index = ((tile.bit0[y % 8] >> (x % 8)) & 1) | (((tile.bit1[y % 8] >> (x % 8)) & 1) << 1);
+			bool shown = std::find(kept.begin(), kept.end(), data[i]) != kept.end();
+			if (shown ? from_rgba.palette[index] != data[i] : index != 0) {
+				mismatches.add("art " + std::to_string(trial) + ": pixel (" + std::to_string(x) + ", " + std::to_string(y) + ") is drawn wrong");
+				break;
+			}
+		}
+
+		//round trip through both kinds of PNG (fewer trials, since this writes files):
+		if (trial % 10 < 4) {
+			save_png(rgba_file, indexed.size, data.data(), LowerLeftOrigin);
+			save_png_indexed(indexed_file, indexed, LowerLeftOrigin);
+			clear_png_cache(); //(so a file rewritten within the same mtime tick isn't served stale)
+			std::shared_ptr< PNGImage const > rgba_png = load_png_cached(rgba_file, LowerLeftOrigin);
+			std::shared_ptr< PNGImage const > indexed_png = load_png_cached(indexed_file, LowerLeftOrigin);
+			if (rgba_png->indexed || !indexed_png->indexed) {
+				mismatches.add("art " + std::to_string(trial) + ": PNGs didn't load as the expected color types");
+			} else if (!same(SpriteBundle::encode(*rgba_png), from_rgba) || !same(SpriteBundle::encode(*indexed_png), from_rgba)) {
+				mismatches.add("art " + std::to_string(trial) + ": saved as RGBA and palette-type PNGs, encodes differently");
+			}
+		}
+	}
+	clear_png_cache();
+	std::remove(rgba_file.c_str());
+	std::remove(indexed_file.c_str());
+	return mismatches.count;
+}
+
+//run every check with every set of kernels; returns the number of mismatches:
+static uint32_t verify() {
+	BitplanesKernels chosen = bitplanes_kernels();
+	uint32_t mismatches = 0;
+	for (BitplanesKernels kernels : { BitplanesPortable, BitplanesSSE2, BitplanesAVX2 }) {
+		if (!bitplanes_use_kernels(kernels)) {
+			std::cout << "skipping " << bitplanes_kernels_name(kernels) << " kernels (not supported by this CPU)\n";
+			continue;
+		}
+		std::cout << "checking " << bitplanes_kernels_name(kernels) << " kernels...\n";
+		mismatches += verify_bitplanes(kernels);
+		mismatches += verify_box_overlap(kernels);
+	}
+	bitplanes_use_kernels(chosen);
+
+	std::cout << "checking CollisionGrid...\n";
+	mismatches += verify_collision_grid();
+
+	std::cout << "checking render_to_buffer...\n";
+	mismatches += verify_render();
+
+	std::cout << "checking sprite encoding...\n";
+	mismatches += verify_sprite_encoding();
+	return mismatches;
+}
+
+//---------------------------------------------
+
+struct Result {
+	double build = 0.0, pack = 0.0, raster = 0.0; //ns/frame
+	double allocations = 0.0, bytes = 0.0; //per frame
+};
+
+static Result run(Scene &scene, uint32_t frames, bool raster, uint64_t *checksum) {
+	typedef std::chrono::steady_clock Clock;
+	auto ns = [](Clock::time_point a, Clock::time_point b) {
+		return double(std::chrono::duration_cast< std::chrono::nanoseconds >(b - a).count());
+	};
+
+	PPU466 ppu;
+	Stages stages;
+	scene.setup(ppu);
+
+	//warm up (first frames expand every tile, size the raster buffer, etc):
+	for (uint32_t frame = 0; frame < 8; ++frame) {
+		scene.update(ppu, frame);
+		stages.build(ppu);
+		stages.pack();
+		if (raster) stages.rasterize(ppu);
+	}
+
+	Result result;
+	AllocationScope allocations(AllocationDraw);
+	AllocationCounts before = allocation_total_counts(AllocationDraw);
+	for (uint32_t frame = 8; frame < 8 + frames; ++frame) {
+		scene.update(ppu, frame);
+		auto t0 = Clock::now();
+		stages.build(ppu);
+		auto t1 = Clock::now();
+		stages.pack();
+		auto t2 = Clock::now();
+		if (raster) stages.rasterize(ppu);
+		auto t3 = Clock::now();
+		result.build += ns(t0, t1);
+		result.pack += ns(t1, t2);
+		result.raster += ns(t2, t3);
+	}
+	AllocationCounts after = allocation_total_counts(AllocationDraw);
+	result.allocations = double(after.allocations - before.allocations);
+	result.bytes = double(after.bytes - before.bytes);
+
+	result.build /= frames;
+	result.pack /= frames;
+	result.raster /= frames;
+	result.allocations /= frames;
+	result.bytes /= frames;
+
+	*checksum += stages.checksum;
+	return result;
+}
+
+int main(int argc, char **argv) {
+	std::string scene_name = "all";
+	uint32_t frames = 10000;
+	bool raster = false;
+
+	auto usage = [&]() {
+		std::cerr << "usage:\n\t" << argv[0] << " [--scene empty|shrimp|churn|all] [--frames N] [--kernels portable|sse2|avx2] [--raster]\n\t" << argv[0] << " --verify" << std::endl;
+		return 1;
+	};
+
+	for (int argi = 1; argi < argc; ++argi) {
+		std::string arg = argv[argi];
+		if (arg == "--scene" && argi + 1 < argc) {
+			scene_name = argv[++argi];
+		} else if (arg == "--frames" && argi + 1 < argc) {
+			frames = uint32_t(std::max(1L, std::strtol(argv[++argi], nullptr, 10)));
+		} else if (arg == "--kernels" && argi + 1 < argc) {
+			std::string name = argv[++argi];
+			BitplanesKernels kernels;
+			if (name == "portable") kernels = BitplanesPortable;
+			else if (name == "sse2") kernels = BitplanesSSE2;
+			else if (name == "avx2") kernels = BitplanesAVX2;
+			else return usage();
+			if (!bitplanes_use_kernels(kernels)) {
+				std::cerr << "This CPU can't run the '" << name << "' kernels." << std::endl;
+				return 1;
+			}
+		} else if (arg == "--raster") {
+			raster = true;
+		} else if (arg == "--verify" && argc == 2) {
+			uint32_t mismatches = verify();
+			std::cout << (mismatches ? std::to_string(mismatches) + " mismatches." : std::string("Everything matches.")) << std::endl;
+			return mismatches ? 1 : 0;
+		} else {
+			return usage();
+		}
+	}
+
+	EmptyScene empty;
+	ShrimpScene shrimp;
+	ChurnScene churn;
+	std::vector< std::pair< char const *, Scene * > > scenes;
+	if (scene_name == "empty" || scene_name == "all") scenes.emplace_back("empty", &empty);
+	if (scene_name == "shrimp" || scene_name == "all") scenes.emplace_back("shrimp", &shrimp);
+	if (scene_name == "churn" || scene_name == "all") scenes.emplace_back("churn", &churn);
+	if (scenes.empty()) return usage();
+
+	std::cout << "ppu-bench: " << frames << " frames per scene, " << bitplanes_kernels_name(bitplanes_kernels()) << " bitplanes kernels; stage times in ns/frame\n";
+	std::cout << std::left << std::setw(8) << "scene" << std::right
+		<< std::setw(10) << "build" << std::setw(10) << "pack";
+	if (raster) std::cout << std::setw(10) << "raster";
+	std::cout << std::setw(10) << "total"
+		<< std::setw(14) << "allocs/frame" << std::setw(14) << "bytes/frame" << "\n";
+
+	uint64_t checksum = 0;
+	std::cout << std::fixed << std::setprecision(1);
+	for (auto const &named : scenes) {
+		Result r = run(*named.second, frames, raster, &checksum);
+		std::cout << std::left << std::setw(8) << named.first << std::right
+			<< std::setw(10) << r.build << std::setw(10) << r.pack;
+		if (raster) std::cout << std::setw(10) << r.raster;
+		std::cout << std::setw(10) << (r.build + r.pack + r.raster)
+			<< std::setw(14) << r.allocations << std::setw(14) << r.bytes << "\n";
+	}
+
+	//expanding the whole tile table with each set of kernels this CPU supports:
+	{
+		BitplanesKernels chosen = bitplanes_kernels();
+		PPU466 ppu;
+		std::array< uint8_t, 128 * 128 > tile_texture;
+		std::cout << "\ntile table expansion (all 256 tiles):\n";
+		for (BitplanesKernels kernels : { BitplanesPortable, BitplanesSSE2, BitplanesAVX2 }) {
+			if (!bitplanes_use_kernels(kernels)) continue;
+			const uint32_t reps = std::max(1U, frames / 10);
+			auto before = std::chrono::steady_clock::now();
+			for (uint32_t rep = 0; rep < reps; ++rep) {
+				for (uint32_t i = 0; i < ppu.tile_table.size(); ++i) {
+					bitplanes_expand_tile(ppu.tile_table[i], &tile_texture[(i % 16) * 8 + 128 * ((i / 16) * 8)], 128);
+				}
+			}
+			auto after = std::chrono::steady_clock::now();
+			std::cout << "  " << std::left << std::setw(10) << bitplanes_kernels_name(kernels) << std::right
+				<< std::setw(10) << std::chrono::duration< double, std::nano >(after - before).count() / reps << " ns\n";
+		}
+		bitplanes_use_kernels(chosen);
+		checksum += tile_texture[checksum % tile_texture.size()];
+	}
+
+	//encoding a full 128x128 sheet of tiles, one 8x8 tile at a time (like SpriteBundle::encode does for
+	// each sprite) versus in one pass with import_tile_sheet:
+	{
+		PPU466 ppu;
+		PPU466::Palette palette = {
+			glm::u8vec4(0x00, 0x00, 0x00, 0x00), glm::u8vec4(0xff, 0x00, 0x00, 0xff),
+			glm::u8vec4(0x00, 0xff, 0x00, 0xff), glm::u8vec4(0x00, 0x00, 0xff, 0xff),
+		};
+		glm::uvec2 size(128, 128);
+		std::vector< glm::u8vec4 > sheet(size.x * size.y);
+		std::mt19937 mt(0x15466);
+		for (auto &px : sheet) px = palette[mt() % 4];
+
+		const uint32_t reps = std::max(1U, frames / 10);
+		auto before = std::chrono::steady_clock::now();
+		for (uint32_t rep = 0; rep < reps; ++rep) {
+			for (uint32_t i = 0; i < ppu.tile_table.size(); ++i) {
+				std::array< uint8_t, 8 * 8 > indices;
+				for (uint32_t y = 0; y < 8; ++y) {
+					bitplanes_colors_to_indices(&sheet[((i / 16) * 8 + y) * size.x + (i % 16) * 8], 8, palette, &indices[8 * y]);
+				}
+				ppu.tile_table[i] = bitplanes_pack_tile(indices.data(), 8);
+			}
+		}
+		auto middle = std::chrono::steady_clock::now();
+		for (uint32_t rep = 0; rep < reps; ++rep) {
+			import_tile_sheet(ppu, 0, palette, size, sheet);
+		}
+		auto after = std::chrono::steady_clock::now();
+
+		std::cout << "\ntile sheet encoding (128x128 pixels, 256 tiles):\n";
+		std::cout << "  " << std::left << std::setw(10) << "per-tile" << std::right
+			<< std::setw(10) << std::chrono::duration< double, std::nano >(middle - before).count() / reps << " ns\n";
+		std::cout << "  " << std::left << std::setw(10) << "sheet" << std::right
+			<< std::setw(10) << std::chrono::duration< double, std::nano >(after - middle).count() / reps << " ns\n";
+		checksum += ppu.tile_table[checksum % ppu.tile_table.size()].bit0[0];
+	}
+
+	//testing a player-sized box against many 16x16 entity boxes: a float loop over glm::vec2 positions
+	// (how ShrimpMode used to test each sprite) versus box_overlap_16x16 with each set of kernels:
+	{
+		BitplanesKernels chosen = bitplanes_kernels();
+		std::cout << "\nentity box overlap (ns/query):\n";
+		std::cout << "  " << std::left << std::setw(10) << "entities" << std::right << std::setw(12) << "float";
+		for (BitplanesKernels kernels : { BitplanesPortable, BitplanesSSE2, BitplanesAVX2 }) {
+			if (bitplanes_use_kernels(kernels)) std::cout << std::setw(12) << bitplanes_kernels_name(kernels);
+		}
+		std::cout << "\n";
+		for (uint32_t count : { 100U, 10000U, 1000000U }) {
+			std::mt19937 mt(count);
+			std::vector< int16_t > xs(count), ys(count);
+			std::vector< glm::vec2 > positions(count);
+			for (uint32_t i = 0; i < count; ++i) {
+				xs[i] = int16_t(int32_t(mt() % 272) - 16);
+				ys[i] = int16_t(int32_t(mt() % 256) - 16);
+				positions[i] = glm::vec2(xs[i], ys[i]);
+			}
+			std::vector< uint64_t > hits((count + 63) / 64);
+			glm::vec2 min(120.5f, 112.0f), max(136.5f, 128.0f);
+			//(about the same number of box tests for each count)
+			const uint32_t reps = std::max(1U, uint32_t(uint64_t(frames) * 10000 / count));
+
+			auto before = std::chrono::steady_clock::now();
+			for (uint32_t rep = 0; rep < reps; ++rep) {
+				uint32_t total = 0;
+				for (uint32_t i = 0; i < count; ++i) {
+					glm::vec2 const &at = positions[i];
+					bool hit = at.x <= max.x && at.x + 16.0f >= min.x && at.y <= max.y && at.y + 16.0f >= min.y;
+					if (i % 64 == 0) hits[i / 64] = 0;
+					hits[i / 64] |= uint64_t(hit) << (i % 64);
+					total += hit;
+				}
+				checksum += total;
+			}
+			auto after = std::chrono::steady_clock::now();
+			std::cout << "  " << std::left << std::setw(10) << count << std::right
+				<< std::setw(12) << std::chrono::duration< double, std::nano >(after - before).count() / reps;
+
+			for (BitplanesKernels kernels : { BitplanesPortable, BitplanesSSE2, BitplanesAVX2 }) {
+				if (!bitplanes_use_kernels(kernels)) continue;
+				before = std::chrono::steady_clock::now();
+				for (uint32_t rep = 0; rep < reps; ++rep) {
+					checksum += box_overlap_16x16(xs.data(), ys.data(), count, min, max, hits.data());
+				}
+				after = std::chrono::steady_clock::now();
+				std::cout << std::setw(12) << std::chrono::duration< double, std::nano >(after - before).count() / reps;
+			}
+			std::cout << "\n";
+			checksum += hits[checksum % hits.size()];
+		}
+		bitplanes_use_kernels(chosen);
+	}
+
+	//decoding a folder's worth of PNGs one after another versus all at once with load_png_batch:
+	// (writes the images to the current directory, and removes them afterward)
+	{
+		const uint32_t count = 32;
+		glm::uvec2 size(128, 128);
+		std::vector< std::string > filenames;
+		std::mt19937 mt(0x15466);
+		for (uint32_t i = 0; i < count; ++i) {
+			std::vector< glm::u8vec4 > data(size.x * size.y);
+			for (auto &px : data) px = glm::u8vec4(mt() % 4 * 0x55, mt() % 4 * 0x55, mt() % 4 * 0x55, 0xff);
+			filenames.emplace_back("ppu-bench-" + std::to_string(i) + ".png");
+			save_png(filenames.back(), size, data.data(), LowerLeftOrigin);
+		}
+
+		const uint32_t reps = std::max(1U, frames / 2000);
+		double serial = 0.0, batch = 0.0;
+		for (uint32_t rep = 0; rep < reps; ++rep) {
+			clear_png_cache(); //(so every load decodes)
+			auto before = std::chrono::steady_clock::now();
+			for (auto const &filename : filenames) {
+				checksum += load_png_cached(filename, LowerLeftOrigin)->data[0].r;
+			}
+			auto middle = std::chrono::steady_clock::now();
+			clear_png_cache();
+			std::unique_ptr< PNGBatch > loading = load_png_batch(filenames, LowerLeftOrigin);
+			for (auto &image : loading->images) {
+				checksum += image.get()->data[0].r;
+			}
+			auto after = std::chrono::steady_clock::now();
+			serial += std::chrono::duration< double, std::milli >(middle - before).count();
+			batch += std::chrono::duration< double, std::milli >(after - middle).count();
+		}
+		clear_png_cache();
+		for (auto const &filename : filenames) {
+			std::remove(filename.c_str());
+		}
+
+		std::cout << "\npng loading (" << count << " files, " << size.x << "x" << size.y << " pixels each):\n";
+		std::cout << "  " << std::left << std::setw(10) << "serial" << std::right
+			<< std::setw(10) << serial / reps << " ms\n";
+		std::cout << "  " << std::left << std::setw(10) << "batch" << std::right
+			<< std::setw(10) << batch / reps << " ms (" << std::max(1U, std::thread::hardware_concurrency()) << " threads)\n";
+	}
+
+	//(printing the checksum keeps the work from being optimized away)
+	std::cout << "\n(checksum " << std::hex << checksum << std::dec << ")" << std::endl;
+	return 0;
+}
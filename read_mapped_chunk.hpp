@@ -0,0 +1,94 @@
+#pragma once
+
+#include "read_write_chunk.hpp"
+
+#include <string>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+//A read-only memory-mapped file:
+// (mapped with mmap on Linux/MacOS and a file mapping on Windows; throws on error)
+struct MappedFile {
+	MappedFile(std::string const &filename);
+	~MappedFile();
+	MappedFile(MappedFile const &) = delete;
+	MappedFile &operator=(MappedFile const &) = delete;
+
+	std::string filename;
+	uint8_t const *data = nullptr; //start of the file; page-aligned
+	size_t size = 0; //in bytes
+
+private:
+#ifdef _WIN32
+	void *file_handle = nullptr;
+	void *mapping_handle = nullptr;
+#endif
+};
+
+//A typed, read-only view of the data of a chunk, pointing directly into the mapping:
+// (only valid as long as the MappedFile it came from)
+template< typename T >
+struct ChunkSpan {
+	T const *data = nullptr;
+	size_t count = 0;
+
+	T const *begin() const { return data; }
+	T const *end() const { return data + count; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	T const &operator[](size_t i) const { return data[i]; }
+};
+
+//helper function that reads a chunk (in the format written by write_chunk) from a mapped file in place:
+// starts at byte *offset of the file, skips any pad chunks, checks the header,
+// and advances *offset past the chunk.
+//The chunk's data must start at a multiple of alignof(T) -- write_chunk guarantees this
+// for any T with alignof(T) <= ChunkAlignment.
+template< typename T >
+ChunkSpan< T > read_chunk(MappedFile const &from, size_t *offset_, std::string const &magic) {
+	static_assert(std::is_trivially_copyable< T >::value, "chunk data is used in place, so must be plain data");
+	static_assert(alignof(T) <= ChunkAlignment, "write_chunk only aligns data to ChunkAlignment");
+	assert(offset_);
+	size_t &offset = *offset_;
+
+	struct ChunkHeader {
+		char magic[4];
+		uint32_t size;
+	};
+	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+
+	ChunkHeader header;
+	while (true) {
+		if (offset > from.size || from.size - offset < sizeof(header)) {
+			throw std::runtime_error("Failed to read chunk header from '" + from.filename + "'");
+		}
+		std::memcpy(&header, from.data + offset, sizeof(header));
+		offset += sizeof(header);
+		if (std::string(header.magic,4) != "pad0") break;
+		//skip padding:
+		if (from.size - offset < header.size) {
+			throw std::runtime_error("Padding chunk runs off the end of '" + from.filename + "'");
+		}
+		offset += header.size;
+	}
+	if (std::string(header.magic,4) != magic) {
+		throw std::runtime_error("Unexpected magic number in chunk in '" + from.filename + "'");
+	}
+	if (header.size % sizeof(T) != 0) {
+		throw std::runtime_error("Size of chunk not divisible by element size in '" + from.filename + "'");
+	}
+	if (from.size - offset < header.size) {
+		throw std::runtime_error("Chunk runs off the end of '" + from.filename + "'");
+	}
+	if (offset % alignof(T) != 0) {
+		throw std::runtime_error("Chunk data misaligned in '" + from.filename + "' (was it written without padding?)");
+	}
+
+	ChunkSpan< T > ret;
+	ret.data = reinterpret_cast< T const * >(from.data + offset);
+	ret.count = header.size / sizeof(T);
+	offset += header.size;
+	return ret;
+}
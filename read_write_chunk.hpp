@@ -10,6 +10,12 @@
 // |ma|gi|c.|..| <-- four byte "magic number"
 // |sz|sz|sz|sz| <-- four byte (native endian) size
 // |TT...TT| * (sz/sizeof(TT)) <-- enough T structures to make up sz bytes
+//
+//write_chunk also places each chunk's data at a multiple of ChunkAlignment bytes from the
+// start of the file, by writing a 'pad chunk' (magic "pad0") before it if needed.
+// readers skip over pad chunks, and the alignment means a memory-mapped file
+// can be used in place (see read_mapped_chunk.hpp).
+enum : uint32_t { ChunkAlignment = 16 };
 
 template< typename T >
 void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *to_) {
@@ -23,8 +29,15 @@ void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *
 	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
 
 	ChunkHeader header;
-	if (!from.read(reinterpret_cast< char * >(&header), sizeof(header))) {
-		throw std::runtime_error("Failed to read chunk header");
+	while (true) {
+		if (!from.read(reinterpret_cast< char * >(&header), sizeof(header))) {
+			throw std::runtime_error("Failed to read chunk header");
+		}
+		if (std::string(header.magic,4) != "pad0") break;
+		//skip padding:
+		if (!from.ignore(header.size)) {
+			throw std::runtime_error("Failed to skip padding chunk");
+		}
 	}
 	if (std::string(header.magic,4) != magic) {
 		throw std::runtime_error("Unexpected magic number in chunk");
@@ -53,6 +66,19 @@ void write_chunk(std::string const &magic, std::vector< T > const &from, std::os
 		uint32_t size = 0;
 	};
 	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+
+	//pad so the data starts at a multiple of ChunkAlignment:
+	// (streams that can't report their position just don't get padded)
+	std::streamoff at = to.tellp();
+	if (at >= 0 && (at + std::streamoff(sizeof(ChunkHeader))) % ChunkAlignment != 0) {
+		ChunkHeader pad;
+		pad.magic[0] = 'p'; pad.magic[1] = 'a'; pad.magic[2] = 'd'; pad.magic[3] = '0';
+		pad.size = uint32_t((ChunkAlignment - at % ChunkAlignment) % ChunkAlignment);
+		const char zeros[ChunkAlignment] = { 0 };
+		to.write(reinterpret_cast< const char * >(&pad), sizeof(pad));
+		to.write(zeros, pad.size);
+	}
+
 	ChunkHeader header;
 	header.magic[0] = magic[0];
 	header.magic[1] = magic[1];